@@ -3,6 +3,7 @@
 #include <avr/io.h>
 // #include <util/delay.h>
 #include "Port.h"
+#include "PowerReduction.h"
 
 // TODO: The ADC can be used for other puproses than just reading analog values.
 // This code should be refactored into a dedicated ADC class to be more generic.
@@ -24,6 +25,7 @@ public:
     AnalogInputPin(AdcReference reference = AdcReference::VCC)
     {
         // Enable ADC
+        PowerReduction::Adc(PowerState::On);
         ADCSRA |= (1 << ADEN);
 
         // Set reference voltage
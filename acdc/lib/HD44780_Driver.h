@@ -32,7 +32,7 @@ public:
      */
     bool WriteCommand(uint8_t cmd)
     {
-        Trace("WriteCommand");
+        Trace(DebugLog_Id("WriteCommand"));
         BaseT::SetRs(false);
         return Write8(cmd);
     }
@@ -43,7 +43,7 @@ public:
      */
     bool WriteData(uint8_t data)
     {
-        Trace("WriteData");
+        Trace(DebugLog_Id("WriteData"));
         BaseT::SetRs(true);
         return Write8(data);
     }
@@ -78,7 +78,7 @@ protected:
 private:
     bool PulseEnable()
     {
-        Trace("PulseEnable");
+        Trace(DebugLog_Id("PulseEnable"));
         BaseT::SetEnable(false);
         if (!BaseT::WriteIO())
             return false;
@@ -89,8 +89,8 @@ private:
         return BaseT::WriteIO();
     }
 
-    static void Trace(const char *msg)
+    static void Trace(uint16_t messageId)
     {
-        LogTrace<DebugComponentId>(msg);
+        LogTrace<DebugComponentId>(messageId);
     }
 };
\ No newline at end of file
@@ -0,0 +1,147 @@
+#pragma once
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include "PowerReduction.h"
+#include "atl/LockScope.h"
+
+/** The IdleSleep puts the MCU in SLEEP_MODE_IDLE when there is nothing to do.
+ *  In idle mode the CPU clock stops but all peripherals keep running:
+ *  any interrupt (Timer0 overflow, USART RX, TWI, pin change) wakes the MCU.
+ *  Waking from idle takes 4 extra cycles on top of the normal interrupt response (datasheet).
+ *
+ *  The wake-to-handle latency (ISR to the task that handles it) can be measured:
+ *  call `MarkWake()` in the ISR and `MeasureWake()` in the task.
+ *  Only mark the interrupts that the measuring task handles: a mark is kept until the next measurement.
+ *  The resolution is that of TimerCounterT::getMicroseconds() (4us for Timer0 at 16MHz).
+ *
+ *  IdleSleep is a static class and cannot be instantiated.
+ *  \tparam TimerCounterT is the timer used for measuring the wake latency. It implements `static uint32_t getMicroseconds()`.
+ */
+template <class TimerCounterT>
+class IdleSleep
+{
+public:
+    /** Selects idle sleep mode and switches off the peripherals that are not in use.
+     *  Call at the end of initialization, after all drivers have been opened.
+     *  A peripheral that is used later is switched on by its driver.
+     */
+    static void Open()
+    {
+        set_sleep_mode(SLEEP_MODE_IDLE);
+        PowerDownUnused();
+    }
+
+    /** Switches off the ADC, SPI, Timer1 and Timer2 if they are not enabled.
+     *  Also switches off the analog comparator.
+     */
+    static void PowerDownUnused()
+    {
+        // analog comparator off
+        ACSR |= (1 << ACD);
+
+        if ((ADCSRA & (1 << ADEN)) == 0)
+            PowerReduction::Adc(PowerState::Off);
+        if ((SPCR & (1 << SPE)) == 0)
+            PowerReduction::Spi(PowerState::Off);
+        // no clock selected: timer is stopped
+        if ((TCCR1B & ((1 << CS12) | (1 << CS11) | (1 << CS10))) == 0)
+            PowerReduction::Timer1(PowerState::Off);
+        if ((TCCR2B & ((1 << CS22) | (1 << CS21) | (1 << CS20))) == 0)
+            PowerReduction::Timer2(PowerState::Off);
+    }
+
+    /** Sleeps until the next interrupt, unless the scheduler has a ready task.
+     *  The check and going to sleep are atomic, so a task that is signaled
+     *  from an interrupt just before sleeping is not missed.
+     *  \tparam SchedulerT is the TaskScheduler. It implements `static bool getHasReady()`.
+     *  \return Returns true if the MCU has slept.
+     */
+    template <class SchedulerT>
+    static bool Enter()
+    {
+        cli();
+        if (SchedulerT::getHasReady())
+        {
+            sei();
+            return false;
+        }
+
+        sleep_enable();
+        // the instruction after sei is always executed before an interrupt
+        sei();
+        sleep_cpu();
+        sleep_disable();
+
+        _sleepCount++;
+        return true;
+    }
+
+    /** Call this method from an ISR that wakes a task.
+     *  Only the first mark (since the last measurement) is kept.
+     */
+    static void MarkWake()
+    {
+        if (_wokeAt == 0)
+            _wokeAt = TimerCounterT::getMicroseconds() | 1;
+    }
+
+    /** Call this method from the task that was woken.
+     *  Calculates the latency since `MarkWake()` in microseconds.
+     */
+    static void MeasureWake()
+    {
+        uint32_t wokeAt;
+        {
+            LockScope lock;
+            wokeAt = _wokeAt;
+            _wokeAt = 0;
+        }
+        if (wokeAt == 0)
+            return;
+
+        uint32_t latency = TimerCounterT::getMicroseconds() - wokeAt;
+        _lastLatency = latency > 0xFFFF ? 0xFFFF : latency;
+        if (_lastLatency > _maxLatency)
+            _maxLatency = _lastLatency;
+    }
+
+    /** Returns the last measured wake-to-handle latency in microseconds.
+     */
+    static uint16_t getLastWakeLatency()
+    {
+        return _lastLatency;
+    }
+
+    /** Returns the largest measured wake-to-handle latency in microseconds.
+     */
+    static uint16_t getMaxWakeLatency()
+    {
+        return _maxLatency;
+    }
+
+    /** Returns the number of times the MCU has slept.
+     */
+    static uint32_t getSleepCount()
+    {
+        return _sleepCount;
+    }
+
+private:
+    static volatile uint32_t _wokeAt;
+    static uint16_t _lastLatency;
+    static uint16_t _maxLatency;
+    static uint32_t _sleepCount;
+
+    IdleSleep() {}
+};
+
+template <class TimerCounterT>
+volatile uint32_t IdleSleep<TimerCounterT>::_wokeAt = 0;
+template <class TimerCounterT>
+uint16_t IdleSleep<TimerCounterT>::_lastLatency = 0;
+template <class TimerCounterT>
+uint16_t IdleSleep<TimerCounterT>::_maxLatency = 0;
+template <class TimerCounterT>
+uint32_t IdleSleep<TimerCounterT>::_sleepCount = 0;
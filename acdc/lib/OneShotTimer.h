@@ -0,0 +1,241 @@
+#pragma once
+#include <stdint.h>
+#include <avr/io.h>
+#include "atl/LockScope.h"
+#include "TimerCounter.h"
+
+/** The compare unit of Timer1 used by a OneShotTimer. */
+enum class OneShotChannel : uint8_t
+{
+    A, // OCR1A - ISR(TIMER1_COMPA_vect)
+    B, // OCR1B - ISR(TIMER1_COMPB_vect)
+};
+
+/** The OneShotTimer calls a function from an interrupt at a precise (microsecond) deadline.
+ *  It uses a Timer1 compare unit on top of the FreeRunningTimer1 (0.5us per tick at 16MHz),
+ *  so the deadline does not depend on the main loop. The pending timers are kept sorted on
+ *  deadline and the compare register is armed for the first one in the current 16-bit period;
+ *  later deadlines are armed from the overflow interrupt.
+ *  The callbacks run in the interrupt: keep them short (set a pin, start the ADC, signal a task).
+ *  Use Channel A and B for two independent timer queues.
+ *  Implement `ISR(TIMER1_COMPx_vect)` to call `OnCompareMatchInterrupt()` and
+ *  call `OnTimerOverflowInterrupt()` from `ISR(TIMER1_OVF_vect)` (after FreeRunningTimer1).
+ *
+ *  OneShotTimer is a static class and cannot be instantiated.
+ *  \tparam Channel is the Timer1 compare unit to use.
+ *  \tparam MaxTimers is the maximum number of pending timers.
+ */
+template <const OneShotChannel Channel, const uint8_t MaxTimers = 4>
+class OneShotTimer
+{
+    // a compare value must be at least this far in the future to be hit (ISR latency)
+    static const uint8_t MinLeadTicks = 16;
+
+public:
+    typedef void (*Callback)(void *context);
+
+    static const uint8_t InvalidId = 0;
+
+    /** Starts the FreeRunningTimer1 (if not running).
+     */
+    static void Open()
+    {
+        FreeRunningTimer1::Start();
+    }
+
+    /** Schedules the callback.
+     *  \param microseconds is the delay from now. Deadlines closer than ~8us fire after ~8us.
+     *  \param callback is called from the compare interrupt.
+     *  \param context is passed to the callback.
+     *  \return Returns the id of the timer (for `Cancel()`) or InvalidId when full.
+     */
+    static uint8_t Schedule(uint32_t microseconds, Callback callback, void *context = nullptr)
+    {
+        LockScope lock;
+        return ScheduleAt(FreeRunningTimer1::getTicksLocked() + FreeRunningTimer1::MicrosecondsToTicks(microseconds), callback, context);
+    }
+
+    /** Schedules the callback at an absolute deadline.
+     *  Can be called from a callback (interrupts disabled) to build a sequence without drift.
+     *  \param deadline is in FreeRunningTimer1 ticks.
+     *  \param callback is called from the compare interrupt.
+     *  \param context is passed to the callback.
+     *  \return Returns the id of the timer or InvalidId when full.
+     */
+    static uint8_t ScheduleAt(uint32_t deadline, Callback callback, void *context = nullptr)
+    {
+        LockScope lock;
+        if (_count >= MaxTimers)
+            return InvalidId;
+
+        // keep sorted on deadline (stable)
+        uint32_t now = FreeRunningTimer1::getTicksLocked();
+        uint8_t i = _count;
+        while (i > 0 && (int32_t)(_entries[i - 1].Deadline - now) > (int32_t)(deadline - now))
+        {
+            _entries[i] = _entries[i - 1];
+            i--;
+        }
+
+        _nextId++;
+        if (_nextId == InvalidId)
+            _nextId++;
+
+        _entries[i].Deadline = deadline;
+        _entries[i].Function = callback;
+        _entries[i].Context = context;
+        _entries[i].Id = _nextId;
+        _count++;
+
+        if (i == 0)
+            Arm(now);
+        return _nextId;
+    }
+
+    /** Removes a pending timer.
+     *  \param id is the id returned by `Schedule()`.
+     *  \return Returns false if the timer has already fired (or the id is unknown).
+     */
+    static bool Cancel(uint8_t id)
+    {
+        LockScope lock;
+        for (uint8_t i = 0; i < _count; i++)
+        {
+            if (_entries[i].Id != id)
+                continue;
+
+            Remove(i);
+            if (i == 0)
+                Arm(FreeRunningTimer1::getTicksLocked());
+            return true;
+        }
+        return false;
+    }
+
+    static uint8_t getCount()
+    {
+        return _count;
+    }
+
+    /** Call this method from the `ISR(TIMER1_COMPx_vect)` interrupt handler for the Channel.
+     *  Not meant to be called from regular code.
+     */
+    static void OnCompareMatchInterrupt()
+    {
+        DisableCompare();
+        RunExpired();
+    }
+
+    /** Call this method from the `ISR(TIMER1_OVF_vect)` interrupt handler.
+     *  Arms the compare unit for a deadline that has come within the (new) 16-bit period.
+     */
+    static void OnTimerOverflowInterrupt()
+    {
+        if (_count > 0 && !getIsCompareEnabled())
+            RunExpired();
+    }
+
+private:
+    struct Entry
+    {
+        uint32_t Deadline;
+        Callback Function;
+        void *Context;
+        uint8_t Id;
+    };
+
+    static Entry _entries[MaxTimers];
+    static uint8_t _count;
+    static uint8_t _nextId;
+
+    static void RunExpired()
+    {
+        uint32_t now = FreeRunningTimer1::getTicksLocked();
+        while (_count > 0 && (int32_t)(now - _entries[0].Deadline) >= 0)
+        {
+            Entry entry = _entries[0];
+            Remove(0);
+            // the callback may schedule a new timer
+            entry.Function(entry.Context);
+            now = FreeRunningTimer1::getTicksLocked();
+        }
+        Arm(now);
+    }
+
+    static void Remove(uint8_t index)
+    {
+        _count--;
+        for (uint8_t i = index; i < _count; i++)
+        {
+            _entries[i] = _entries[i + 1];
+        }
+    }
+
+    // arms the compare unit for the first entry if it falls within the current 16-bit period
+    static void Arm(uint32_t now)
+    {
+        DisableCompare();
+        if (_count == 0)
+            return;
+
+        uint32_t deadline = _entries[0].Deadline;
+        if ((int32_t)(deadline - now) < MinLeadTicks)
+            deadline = now + MinLeadTicks;
+
+        // the overflow interrupt will arm it
+        if ((deadline >> 16) != (now >> 16))
+            return;
+
+        EnableCompare((uint16_t)deadline);
+    }
+
+    static void EnableCompare(uint16_t compare)
+    {
+        if (Channel == OneShotChannel::A)
+        {
+            OCR1A = compare;
+            TIFR1 = (1 << OCF1A);
+            TIMSK1 |= (1 << OCIE1A);
+        }
+        else
+        {
+            OCR1B = compare;
+            TIFR1 = (1 << OCF1B);
+            TIMSK1 |= (1 << OCIE1B);
+        }
+    }
+
+    static void DisableCompare()
+    {
+        if (Channel == OneShotChannel::A)
+            TIMSK1 &= ~(1 << OCIE1A);
+        else
+            TIMSK1 &= ~(1 << OCIE1B);
+    }
+
+    static bool getIsCompareEnabled()
+    {
+        if (Channel == OneShotChannel::A)
+            return (TIMSK1 & (1 << OCIE1A)) != 0;
+        return (TIMSK1 & (1 << OCIE1B)) != 0;
+    }
+
+    OneShotTimer() {}
+};
+
+template <const OneShotChannel Channel, const uint8_t MaxTimers>
+typename OneShotTimer<Channel, MaxTimers>::Entry OneShotTimer<Channel, MaxTimers>::_entries[] = {};
+template <const OneShotChannel Channel, const uint8_t MaxTimers>
+uint8_t OneShotTimer<Channel, MaxTimers>::_count = 0;
+template <const OneShotChannel Channel, const uint8_t MaxTimers>
+uint8_t OneShotTimer<Channel, MaxTimers>::_nextId = 0;
+
+// ISR(TIMER1_OVF_vect)
+// {
+//     FreeRunningTimer1::OnTimerOverflowInterrupt();
+//     OneShotTimer<OneShotChannel::A>::OnTimerOverflowInterrupt();
+// }
+// ISR(TIMER1_COMPA_vect)
+// {
+//     OneShotTimer<OneShotChannel::A>::OnCompareMatchInterrupt();
+// }
@@ -89,10 +89,70 @@ public:
     }
 
     // dutyCycle value: 0-4095
+    // between BeginBatch and CommitBatch the value is only collected
     static bool Write(PCA9685_Pins pin, uint16_t dutyCycle)
     {
+        if (dutyCycle > 4095)
+            return false;
+
+        _dutyCycles[(uint8_t)pin] = dutyCycle;
+        if (_batching)
+        {
+            _dirty |= (uint16_t)1 << (uint8_t)pin;
+            return true;
+        }
         return Write(pin, 0, dutyCycle);
     }
+
+    /** Starts collecting the duty cycles of `Write(pin, dutyCycle)` until `CommitBatch()`.
+     */
+    static void BeginBatch()
+    {
+        _batching = true;
+    }
+
+    /** Sends the duty cycles collected since `BeginBatch()` in one I2C transaction (auto increment):
+     *  all outputs change together on the STOP. The pins between the first and the last changed pin
+     *  are sent with their last duty cycle (pins written with an explicit on-time do not mix with batches).
+     *  \return Returns false if the transaction failed (the changes are lost).
+     */
+    static bool CommitBatch()
+    {
+        _batching = false;
+        uint16_t dirty = _dirty;
+        _dirty = 0;
+        if (dirty == 0)
+            return true;
+
+        uint8_t first = 0;
+        while ((dirty & ((uint16_t)1 << first)) == 0)
+            first++;
+        uint8_t last = 15;
+        while ((dirty & ((uint16_t)1 << last)) == 0)
+            last--;
+
+        TwiResult result = I2cT::Start(Address, false);
+        PropagateResult(result, false);
+        result = I2cT::Write((uint8_t)Register::Led0OnL + first * 4);
+        PropagateResult(result, false);
+        for (uint8_t pin = first; pin <= last; pin++)
+        {
+            uint16_t off = _dutyCycles[pin];
+            // on = 0
+            result = I2cT::Write(0);
+            PropagateResult(result, false);
+            result = I2cT::Write(0);
+            PropagateResult(result, false);
+            result = I2cT::Write(off & 0xFF);
+            PropagateResult(result, false);
+            result = I2cT::Write(off >> 8);
+            PropagateResult(result, false);
+        }
+        result = I2cT::Stop();
+        PropagateResult(result, false);
+
+        return true;
+    }
     // on/off value: 0-4095
     static bool Write(PCA9685_Pins pin, uint16_t on, uint16_t off)
     {
@@ -255,6 +315,10 @@ private:
         return BitFlag::getMask<uint8_t>((uint8_t)bit);
     }
 
+    static uint16_t _dutyCycles[16];
+    static uint16_t _dirty;
+    static bool _batching;
+
     PCA9685() {}
 
     static bool TryReadMode1(uint8_t *outData)
@@ -277,3 +341,10 @@ private:
         return I2cT::WriteRegister8(Address, (uint8_t)reg, data) == TwiResult::Ok;
     }
 };
+
+template <class I2cT, const uint8_t Address>
+uint16_t PCA9685<I2cT, Address>::_dutyCycles[] = {};
+template <class I2cT, const uint8_t Address>
+uint16_t PCA9685<I2cT, Address>::_dirty = 0;
+template <class I2cT, const uint8_t Address>
+bool PCA9685<I2cT, Address>::_batching = false;
@@ -34,6 +34,14 @@ public:
     {
         Set(PRR, PRTWI, state);
     }
+    static void Spi(PowerState state)
+    {
+        Set(PRR, PRSPI, state);
+    }
+    static void Adc(PowerState state)
+    {
+        Set(PRR, PRADC, state);
+    }
 #endif // PRR
 
 #ifdef PRR0
@@ -42,22 +50,54 @@ public:
     {
         Set(PRR0, PRUSART0, state);
     }
-#ifdef PRUSART1
-    template <>
-    static void Usart1(PowerState state)
-    {
-        Set(PRR0, PRUSART1, state);
-    }
-#endif
 #endif
 
+    static void Timer0(PowerState state)
+    {
+        Set(PRR0, PRTIM0, state);
+    }
     static void Timer1(PowerState state)
     {
         Set(PRR0, PRTIM1, state);
     }
+    static void Timer2(PowerState state)
+    {
+        Set(PRR0, PRTIM2, state);
+    }
+    static void Twi(PowerState state)
+    {
+        Set(PRR0, PRTWI, state);
+    }
+    static void Spi(PowerState state)
+    {
+        Set(PRR0, PRSPI, state);
+    }
+    static void Adc(PowerState state)
+    {
+        Set(PRR0, PRADC, state);
+    }
 #endif // PRR0
 
 #ifdef PRR1
+#ifdef PRUSART1
+    static void Usart1(PowerState state)
+    {
+        Set(PRR1, PRUSART1, state);
+    }
+#endif
+#ifdef PRUSART2
+    static void Usart2(PowerState state)
+    {
+        Set(PRR1, PRUSART2, state);
+    }
+#endif
+#ifdef PRUSART3
+    static void Usart3(PowerState state)
+    {
+        Set(PRR1, PRUSART3, state);
+    }
+#endif
+
     static void Timer3(PowerState state)
     {
         Set(PRR1, PRTIM3, state);
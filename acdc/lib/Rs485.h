@@ -1,37 +1,368 @@
 #pragma once
 #include <stdint.h>
+#include <avr/io.h>
+#include "atl/Bit.h"
+#include "atl/LockScope.h"
+#include "Usart.h"
 
-// RS485 over usart
-// DirectionPin manages the RS485 driver chip (max485) is sending (true) or receiving (false).
-template <class UsartT, class DirectionPinT>
-class Rs485 : public UsartT
+/** The Rs485 counters (saturate at 0xFFFF).
+ */
+struct Rs485Counters
 {
+    /** Frames completely sent (DE released). */
+    uint16_t FramesSent;
+    /** Frames received for this node (or broadcast). */
+    uint16_t FramesReceived;
+    /** Frames for other nodes (address bytes seen with MPCM on). */
+    uint16_t FramesIgnored;
+    /** Frames dropped because the previous frame was not read yet. */
+    uint16_t FramesDropped;
+    /** Frames dropped on a frame, parity or overrun error. */
+    uint16_t ReceiveErrors;
+    /** Frames dropped because the length byte is too big or the frame was cut short. */
+    uint16_t LengthErrors;
+};
+
+/** The Rs485 class is an interrupt driven half-duplex RS-485 transport for a multi-drop bus.
+ *  A frame is: the address byte (9th bit set), the length byte and length data bytes (9th bit clear).
+ *  The Usart runs with 9 data bits in multi-processor communication mode (MPCM): a node is only
+ *  interrupted for address bytes until it sees its own (or the broadcast) address, so the frames for
+ *  other nodes cost one interrupt each.
+ *
+ *  The driver enable (DE) is asserted for the whole frame and released from the transmit complete
+ *  interrupt, which fires when the last stop bit has left the shift register. The receiver is off
+ *  while transmitting, so the own echo is never received (whatever the /RE wiring).
+ *  One frame is sent and one frame is received at a time (master polled bus).
+ *
+ *  Implement `ISR(USARTn_RX_vect)` to call `OnReceiveInterrupt()`,
+ *  `ISR(USARTn_UDRE_vect)` to call `OnAcceptDataInterrupt()` and
+ *  `ISR(USARTn_TX_vect)` to call `OnTransmitCompleteInterrupt()`.
+ *  \tparam UsartId is the Usart port.
+ *  \tparam DirectionPinT is the DigitalOutputPin for DE (and /RE) of the driver chip (max485): true is sending.
+ *  \tparam MaxLength is the maximum number of data bytes in a frame.
+ */
+template <const UsartIds UsartId, class DirectionPinT, const uint8_t MaxLength = 16>
+class Rs485 : public Usart<UsartId>
+{
+    typedef Usart<UsartId> BaseT;
+    typedef UsartRegisters<UsartId> Registers;
+
 public:
+    /** Frames sent to this address are received by all nodes. */
+    static const uint8_t BroadcastAddress = 0xFF;
+    /** The maximum number of data bytes in a frame (MaxLength). */
+    static const uint8_t MaxFrameLength = MaxLength;
+
     Rs485()
         : _dirPin(false)
     {
     }
 
-    bool TryWrite(uint8_t data)
+    /** Opens the Usart in 9-bit MPCM mode and starts listening for frames.
+     *  \param config is the baud rate etc. The data bits are set to 9.
+     *  \param address is the address of this node (not BroadcastAddress).
+     *  \return Returns false if the config is invalid.
+     */
+    bool Open(UsartConfig config, uint8_t address)
     {
-        if (!getCanWrite())
+        if (address == BroadcastAddress)
             return false;
 
-        _dirPin.Write(true);
-        bool success = UsartT::Transmit.Write(data) == UsartTransmitResult::Success;
+        config.setDataBits(UsartDataBits::Bits9);
+        if (!BaseT::OpenAsync(config))
+            return false;
+
+        _address = address;
         _dirPin.Write(false);
-        return success;
+        Listen();
+
+        // TXC (half-duplex turnaround) and RX. UDRIE is enabled per frame.
+        uint8_t ucsrb = Registers::getUCSRB();
+        Bit<TXEN0>::Set(ucsrb);
+        Bit<TXCIE0>::Set(ucsrb);
+        Bit<RXEN0>::Set(ucsrb);
+        Bit<RXCIE0>::Set(ucsrb);
+        Registers::getUCSRB() = ucsrb;
+        return true;
+    }
+
+    uint8_t getAddress() const
+    {
+        return _address;
+    }
+
+    /** Indicates if a frame is being sent (DE is asserted).
+     */
+    bool getIsSending() const
+    {
+        return _sending;
+    }
+
+    /** Starts sending a frame. Does not wait.
+     *  \param address is the node (or BroadcastAddress) the frame is for.
+     *  \param data is copied.
+     *  \param length is the number of bytes in data (max MaxLength).
+     *  \return Returns false if a frame is still being sent or the length is too big.
+     */
+    bool TryWriteFrame(uint8_t address, const uint8_t *data, uint8_t length)
+    {
+        if (_sending || length > MaxLength)
+            return false;
+
+        for (uint8_t i = 0; i < length; i++)
+        {
+            _txData[i] = data[i];
+        }
+        _txAddress = address;
+        _txLength = length;
+        _txIndex = TxAddressIndex;
+        _sending = true;
+
+        // no echo; a partly received frame is lost
+        Bit<RXEN0>::Clear(Registers::getUCSRB());
+        _rxState = ReceiveState::Idle;
+
+        // a stale TXC flag would release DE too early (the flag is cleared by writing a one)
+        Registers::getUCSRA() = (Registers::getUCSRA() & KeepUcsraMask) | (1 << TXC0);
+        _dirPin.Write(true);
+        Bit<UDRIE0>::Set(Registers::getUCSRB());
+        return true;
     }
 
-    bool TryRead(uint8_t *outData)
+    /** Retrieves the received frame (once).
+     *  \param outData receives the data (MaxLength bytes).
+     *  \param outLength receives the number of data bytes.
+     *  \param outBroadcast is set if the frame was sent to the BroadcastAddress (can be nullptr).
+     *  \return Returns false if no frame has been received.
+     */
+    bool TryReadFrame(uint8_t *outData, uint8_t *outLength, bool *outBroadcast = nullptr)
     {
-        if (!getCanRead())
+        if (!_rxComplete)
             return false;
 
+        for (uint8_t i = 0; i < _rxLength; i++)
+        {
+            outData[i] = _rxData[i];
+        }
+        *outLength = _rxLength;
+        if (outBroadcast != nullptr)
+            *outBroadcast = _rxBroadcast;
+
+        // hand the buffer back to the interrupt
+        _rxComplete = false;
+        return true;
+    }
+
+    /** Retrieves a snapshot of the counters.
+     */
+    Rs485Counters getCounters() const
+    {
+        LockScope lock;
+        return _counters;
+    }
+
+    void ResetCounters()
+    {
+        LockScope lock;
+        _counters = Rs485Counters();
+    }
+
+    /** Call this method from the `ISR(USARTn_UDRE_vect)` interrupt handler.
+     *  Not meant to be called from regular code.
+     */
+    void OnAcceptDataInterrupt()
+    {
+        if (_txIndex == TxAddressIndex)
+        {
+            Bit<TXB80>::Set(Registers::getUCSRB());
+            WriteData(_txAddress);
+            _txIndex = TxLengthIndex;
+            return;
+        }
+
+        Bit<TXB80>::Clear(Registers::getUCSRB());
+        if (_txIndex == TxLengthIndex)
+        {
+            WriteData(_txLength);
+            _txIndex = 0;
+        }
+        else if (_txIndex < _txLength)
+            WriteData(_txData[_txIndex++]);
+        else
+        {
+            // all bytes are in the transmitter: TXC fires when the last one is out
+            Bit<UDRIE0>::Clear(Registers::getUCSRB());
+            _txIndex = TxDoneIndex;
+        }
+    }
+
+    /** Call this method from the `ISR(USARTn_TX_vect)` interrupt handler.
+     *  Not meant to be called from regular code.
+     */
+    void OnTransmitCompleteInterrupt()
+    {
+        // a gap between two bytes (interrupt latency) also fires TXC: keep DE asserted.
+        // (WriteData clears such a TXC, so only the one after the last byte gets here once done)
+        if (_txIndex != TxDoneIndex)
+            return;
+
         _dirPin.Write(false);
-        return UsartT::Receive.TryRead(outData, &result) && result = UsartReceiveResult::Success;
+        _sending = false;
+        Count(_counters.FramesSent);
+
+        Listen();
+        Bit<RXEN0>::Set(Registers::getUCSRB());
+    }
+
+    /** Call this method from the `ISR(USARTn_RX_vect)` interrupt handler.
+     *  Not meant to be called from regular code.
+     */
+    void OnReceiveInterrupt()
+    {
+        // the status and the 9th bit must be read before the data
+        uint8_t status = Registers::getUCSRA();
+        bool isAddress = Bit<RXB80>::IsTrue(Registers::getUCSRB());
+        uint8_t data = Registers::getUDR();
+
+        if (status & ((1 << FE0) | (1 << UPE0) | (1 << DOR0)))
+        {
+            Count(_counters.ReceiveErrors);
+            Listen();
+            return;
+        }
+
+        if (isAddress)
+        {
+            // the previous frame was cut short
+            if (_rxState != ReceiveState::Idle)
+                Count(_counters.LengthErrors);
+
+            if (data != _address && data != BroadcastAddress)
+            {
+                Count(_counters.FramesIgnored);
+                Listen();
+                return;
+            }
+
+            if (_rxComplete)
+            {
+                Count(_counters.FramesDropped);
+                Listen();
+                return;
+            }
+
+            // receive the data bytes that follow
+            _rxBroadcast = data == BroadcastAddress;
+            _rxState = ReceiveState::Length;
+            SetMultiProcessorMode(false);
+            return;
+        }
+
+        switch (_rxState)
+        {
+        case ReceiveState::Length:
+            if (data > MaxLength)
+            {
+                Count(_counters.LengthErrors);
+                Listen();
+                return;
+            }
+            _rxLength = data;
+            _rxIndex = 0;
+            _rxState = ReceiveState::Data;
+            if (data == 0)
+                Accept();
+            break;
+
+        case ReceiveState::Data:
+            _rxData[_rxIndex++] = data;
+            if (_rxIndex >= _rxLength)
+                Accept();
+            break;
+
+        default:
+            break;
+        }
     }
 
 private:
+    enum class ReceiveState : uint8_t
+    {
+        Idle,
+        Length,
+        Data,
+    };
+
+    static const uint8_t TxAddressIndex = 0xFD;
+    static const uint8_t TxLengthIndex = 0xFE;
+    static const uint8_t TxDoneIndex = 0xFF;
+    // the bits of UCSRA that are configuration (FE, DOR and UPE must be written zero)
+    static const uint8_t KeepUcsraMask = (1 << U2X0) | (1 << MPCM0);
+
+    // loads the transmitter and clears a TXC set by a gap before this byte:
+    // UDRE has the higher vector priority, so that TXC would still be pending after the last byte is loaded.
+    static void WriteData(uint8_t data)
+    {
+        Registers::getUDR() = data;
+        Registers::getUCSRA() = (Registers::getUCSRA() & KeepUcsraMask) | (1 << TXC0);
+    }
+
     DirectionPinT _dirPin;
-};
\ No newline at end of file
+    uint8_t _address = BroadcastAddress;
+
+    uint8_t _txData[MaxLength];
+    uint8_t _txAddress = 0;
+    uint8_t _txLength = 0;
+    volatile uint8_t _txIndex = TxDoneIndex;
+    volatile bool _sending = false;
+
+    uint8_t _rxData[MaxLength];
+    uint8_t _rxLength = 0;
+    uint8_t _rxIndex = 0;
+    ReceiveState _rxState = ReceiveState::Idle;
+    bool _rxBroadcast = false;
+    volatile bool _rxComplete = false;
+
+    Rs485Counters _counters = Rs485Counters();
+
+    void Accept()
+    {
+        _rxComplete = true;
+        Count(_counters.FramesReceived);
+        Listen();
+    }
+
+    // wait for the next address byte
+    void Listen()
+    {
+        _rxState = ReceiveState::Idle;
+        SetMultiProcessorMode(true);
+    }
+
+    static void SetMultiProcessorMode(bool enable)
+    {
+        uint8_t ucsra = Registers::getUCSRA() & (1 << U2X0);
+        if (enable)
+            Bit<MPCM0>::Set(ucsra);
+        Registers::getUCSRA() = ucsra;
+    }
+
+    static void Count(uint16_t &counter)
+    {
+        if (counter < 0xFFFF)
+            counter++;
+    }
+};
+
+// ISR(USART_RX_vect)
+// {
+//     rs485.OnReceiveInterrupt();
+// }
+// ISR(USART_UDRE_vect)
+// {
+//     rs485.OnAcceptDataInterrupt();
+// }
+// ISR(USART_TX_vect)
+// {
+//     rs485.OnTransmitCompleteInterrupt();
+// }
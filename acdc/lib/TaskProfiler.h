@@ -0,0 +1,210 @@
+#pragma once
+#include <stdint.h>
+#include "TimerCounter.h"
+#include "atl/TextWriter.h" // F()
+
+/** The TaskProfiler measures the execution time of each task run by the TaskScheduler
+ *  and the period of the main loop.
+ *  It is opt-in: pass it as the MonitorT of the TaskScheduler (the default NoTaskMonitor costs nothing).
+ *
+ *  It uses the FreeRunningTimer1 (clock/8: 0.5us per tick at 16MHz).
+ *  Implement `ISR(TIMER1_OVF_vect)` and call `FreeRunningTimer1::OnTimerOverflowInterrupt()`.
+ *  Measuring a task costs two (locked) counter reads, about 2us per task at 16MHz.
+ *
+ *  Per task it keeps the number of runs and the min, max and total execution time.
+ *  The loop period (time between two `MarkLoop()` calls) is kept as min/max (jitter)
+ *  and in a histogram with power-of-two buckets.
+ *
+ *  TaskProfiler is a static class and cannot be instantiated.
+ *  \tparam MaxTasks is the maximum number of tasks (same as for the TaskScheduler).
+ */
+template <const uint8_t MaxTasks>
+class TaskProfiler
+{
+    // first bucket: period < 16 ticks (8us). each next bucket doubles.
+    static const uint8_t FirstBucketLimit = 16;
+
+public:
+    /** The number of buckets in the loop period histogram. The last bucket holds all longer periods. */
+    static const uint8_t HistogramSize = 12;
+
+    /** Starts the FreeRunningTimer1 (if not running) and clears all measurements.
+     */
+    static void Open()
+    {
+        FreeRunningTimer1::Start();
+        Reset();
+    }
+
+    /** Clears all measurements.
+     */
+    static void Reset()
+    {
+        for (uint8_t i = 0; i < MaxTasks; i++)
+        {
+            _stats[i].Count = 0;
+            _stats[i].Total = 0;
+            _stats[i].Min = 0xFFFFFFFF;
+            _stats[i].Max = 0;
+        }
+        for (uint8_t i = 0; i < HistogramSize; i++)
+        {
+            _histogram[i] = 0;
+        }
+
+        _loopCount = 0;
+        _loopMin = 0xFFFFFFFF;
+        _loopMax = 0;
+        _lastLoop = 0;
+    }
+
+    /** Called by the TaskScheduler before a task runs.
+     *  \param taskId is the id of the task that is about to run.
+     */
+    static void BeginTask(uint8_t taskId)
+    {
+        (void)taskId;
+        _taskStart = FreeRunningTimer1::getTicks();
+    }
+
+    /** Called by the TaskScheduler after a task has run.
+     *  \param taskId is the id of the task that has run.
+     */
+    static void EndTask(uint8_t taskId)
+    {
+        uint32_t duration = FreeRunningTimer1::getTicks() - _taskStart;
+        if (taskId >= MaxTasks)
+            return;
+
+        Stats &stats = _stats[taskId];
+        stats.Count++;
+        stats.Total += duration;
+        if (duration < stats.Min)
+            stats.Min = duration;
+        if (duration > stats.Max)
+            stats.Max = duration;
+    }
+
+    /** Called by the TaskScheduler at the start of each pass of the main loop.
+     */
+    static void MarkLoop()
+    {
+        uint32_t now = FreeRunningTimer1::getTicks();
+        uint32_t lastLoop = _lastLoop;
+        _lastLoop = now;
+        // first pass after a reset has no period
+        if (lastLoop == 0)
+            return;
+
+        uint32_t period = now - lastLoop;
+        _loopCount++;
+        if (period < _loopMin)
+            _loopMin = period;
+        if (period > _loopMax)
+            _loopMax = period;
+
+        uint8_t bucket = 0;
+        uint32_t limit = FirstBucketLimit;
+        while (bucket < HistogramSize - 1 && period >= limit)
+        {
+            limit <<= 1;
+            bucket++;
+        }
+        if (_histogram[bucket] < 0xFFFF)
+            _histogram[bucket]++;
+    }
+
+    /** Writes the measurements as a table (times in us) and clears them.
+     *  \tparam WriterT is the TextWriter to write to.
+     *  \param writer receives the text.
+     */
+    template <class WriterT>
+    static void Dump(WriterT &writer)
+    {
+        writer.WriteLine(F("task count min avg max (us)"));
+        for (uint8_t i = 0; i < MaxTasks; i++)
+        {
+            Stats &stats = _stats[i];
+            if (stats.Count == 0)
+                continue;
+
+            writer.Write(i);
+            writer.Write(' ');
+            writer.Write(stats.Count);
+            writer.Write(' ');
+            writer.Write(TicksToMicroseconds(stats.Min));
+            writer.Write(' ');
+            writer.Write(TicksToMicroseconds(stats.Total / stats.Count));
+            writer.Write(' ');
+            writer.WriteLine(TicksToMicroseconds(stats.Max));
+        }
+
+        writer.Write(F("loop "));
+        writer.Write(_loopCount);
+        if (_loopCount > 0)
+        {
+            writer.Write(' ');
+            writer.Write(TicksToMicroseconds(_loopMin));
+            writer.Write(' ');
+            writer.Write(TicksToMicroseconds(_loopMax));
+            writer.Write(F(" jitter "));
+            writer.Write(TicksToMicroseconds(_loopMax - _loopMin));
+        }
+        writer.WriteLine();
+
+        // bucket upper limits in us: <8 <16 <32 ... and the rest
+        uint32_t limit = FirstBucketLimit;
+        for (uint8_t i = 0; i < HistogramSize; i++)
+        {
+            if (i < HistogramSize - 1)
+                writer.Write('<');
+            else
+                writer.Write(F(">="));
+            writer.Write(TicksToMicroseconds(i < HistogramSize - 1 ? limit : limit >> 1));
+            writer.Write(' ');
+            writer.WriteLine(_histogram[i]);
+            limit <<= 1;
+        }
+
+        Reset();
+    }
+
+private:
+    struct Stats
+    {
+        uint32_t Count;
+        uint32_t Total;
+        uint32_t Min;
+        uint32_t Max;
+    };
+
+    static Stats _stats[MaxTasks];
+    static uint16_t _histogram[HistogramSize];
+    static uint32_t _loopCount;
+    static uint32_t _loopMin;
+    static uint32_t _loopMax;
+    static uint32_t _lastLoop;
+    static uint32_t _taskStart;
+
+    static uint32_t TicksToMicroseconds(uint32_t ticks)
+    {
+        return FreeRunningTimer1::TicksToMicroseconds(ticks);
+    }
+
+    TaskProfiler() {}
+};
+
+template <const uint8_t MaxTasks>
+typename TaskProfiler<MaxTasks>::Stats TaskProfiler<MaxTasks>::_stats[] = {};
+template <const uint8_t MaxTasks>
+uint16_t TaskProfiler<MaxTasks>::_histogram[] = {};
+template <const uint8_t MaxTasks>
+uint32_t TaskProfiler<MaxTasks>::_loopCount = 0;
+template <const uint8_t MaxTasks>
+uint32_t TaskProfiler<MaxTasks>::_loopMin = 0xFFFFFFFF;
+template <const uint8_t MaxTasks>
+uint32_t TaskProfiler<MaxTasks>::_loopMax = 0;
+template <const uint8_t MaxTasks>
+uint32_t TaskProfiler<MaxTasks>::_lastLoop = 0;
+template <const uint8_t MaxTasks>
+uint32_t TaskProfiler<MaxTasks>::_taskStart = 0;
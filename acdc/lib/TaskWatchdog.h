@@ -0,0 +1,201 @@
+#pragma once
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/wdt.h>
+#include "atl/LockScope.h"
+
+/** Survives a (watchdog) reset: the .noinit section is not cleared at startup.
+ *  Only valid when Magic is set.
+ */
+struct TaskWatchdogResetInfo
+{
+    static const uint16_t MagicValue = 0x5744; // 'WD'
+
+    uint16_t Magic;
+    uint8_t TaskId;
+    uint8_t ResetFlags;
+};
+
+TaskWatchdogResetInfo taskWatchdogResetInfo __attribute__((section(".noinit")));
+
+// After a watchdog reset the WDT stays enabled (at 16ms): disable it before main and the constructors run.
+void TaskWatchdogEarlyInit() __attribute__((naked, used, section(".init3")));
+void TaskWatchdogEarlyInit()
+{
+    taskWatchdogResetInfo.ResetFlags = MCUSR;
+    MCUSR = 0;
+    wdt_disable();
+}
+
+/** The TaskWatchdog supervises the tasks of the TaskScheduler with the AVR watchdog (WDT).
+ *  Each supervised task has a maximum execution time and/or a heartbeat interval
+ *  (the maximum time between two runs). The WDT is kicked once per pass of the main loop,
+ *  but only while all supervised tasks are healthy.
+ *
+ *  The WDT runs in interrupt and reset mode: on a timeout the WDT interrupt calls the safe stop
+ *  function (all motors off, no I2C), records the offending task id in .noinit RAM and resets.
+ *  After the reset `TryTakeResetTaskId()` reports it.
+ *  A task that hangs is caught because the loop never kicks the WDT while it runs.
+ *
+ *  Pass it as the MonitorT of the TaskScheduler (or in a TaskMonitors).
+ *  Implement `ISR(WDT_vect)` to call `OnWatchdogInterrupt()`.
+ *  TaskWatchdog is a static class and cannot be instantiated.
+ *  \tparam TimeT is the Time class of the scheduler. TimeT implements `uint32_t getTicks()`.
+ *  \tparam CounterT is the live time counter for the execution times (TimeT only updates once per loop).
+ *  CounterT implements `uint32_t getMilliseconds()`.
+ *  \tparam MaxTasks is the maximum number of tasks (same as for the TaskScheduler).
+ */
+template <class TimeT, class CounterT, const uint8_t MaxTasks>
+class TaskWatchdog
+{
+public:
+    typedef void (*SafeStopFunction)();
+
+    /** The task id that is recorded when no task can be blamed (the loop itself hangs). */
+    static const uint8_t NoTaskId = 0xFF;
+
+    /** Enables the WDT in interrupt and reset mode.
+     *  \param timeout is the WDT timeout (WDTO_xxx from avr/wdt.h).
+     *  \param safeStop is called from the WDT interrupt before the reset. It must not use I2C or wait.
+     */
+    static void Open(uint8_t timeout, SafeStopFunction safeStop)
+    {
+        _safeStop = safeStop;
+        _current = NoTaskId;
+        _offender = NoTaskId;
+
+        uint8_t prescaler = (timeout & 0x07) | ((timeout & 0x08) ? (1 << WDP3) : 0);
+
+        LockScope lock;
+        wdt_reset();
+        // timed sequence: the new value must be written within 4 cycles
+        WDTCSR = (1 << WDCE) | (1 << WDE);
+        WDTCSR = (1 << WDIE) | (1 << WDE) | prescaler;
+    }
+
+    /** Supervises the task.
+     *  \param taskId is the id from `TaskScheduler::Register()`.
+     *  \param maxExecution is the maximum execution time (ticks of TimeT) of one run. 0 to not check.
+     *  It is checked in milliseconds (rounded up) of the CounterT.
+     *  \param heartbeat is the maximum time (ticks of TimeT) between two runs. 0 to not check (event tasks).
+     */
+    static void Supervise(uint8_t taskId, uint16_t maxExecution, uint16_t heartbeat)
+    {
+        if (taskId >= MaxTasks)
+            return;
+
+        uint32_t ticksPerMillisecond = TimeT::ForMilliseconds(1);
+        _maxExecution[taskId] = (maxExecution + ticksPerMillisecond - 1) / ticksPerMillisecond;
+        _heartbeat[taskId] = heartbeat;
+        _lastRun[taskId] = TimeT::getTicks();
+    }
+
+    /** Indicates if the MCU was reset by the watchdog.
+     *  Valid from the start (read in .init3), also before `Open()`.
+     *  \return Returns true if the last reset was a watchdog reset.
+     */
+    static bool getIsWatchdogReset()
+    {
+        return (taskWatchdogResetInfo.ResetFlags & (1 << WDRF)) != 0;
+    }
+
+    /** Retrieves (once) the task that caused the last watchdog reset.
+     *  \param outTaskId receives the task id (or NoTaskId).
+     *  \return Returns true if the last reset was caused by the TaskWatchdog.
+     */
+    static bool TryTakeResetTaskId(uint8_t *outTaskId)
+    {
+        if (taskWatchdogResetInfo.Magic != TaskWatchdogResetInfo::MagicValue ||
+            !getIsWatchdogReset())
+            return false;
+
+        taskWatchdogResetInfo.Magic = 0;
+        *outTaskId = taskWatchdogResetInfo.TaskId;
+        return true;
+    }
+
+    static void BeginTask(uint8_t taskId)
+    {
+        _current = taskId;
+        _taskStart = CounterT::getMilliseconds();
+    }
+
+    static void EndTask(uint8_t taskId)
+    {
+        _current = NoTaskId;
+        if (taskId >= MaxTasks)
+            return;
+
+        _lastRun[taskId] = TimeT::getTicks();
+        if (_maxExecution[taskId] > 0 &&
+            CounterT::getMilliseconds() - _taskStart > _maxExecution[taskId] &&
+            _offender == NoTaskId)
+            _offender = taskId;
+    }
+
+    /** Kicks the WDT when all supervised tasks are healthy.
+     */
+    static void MarkLoop()
+    {
+        if (_offender != NoTaskId)
+            return;
+
+        uint32_t now = TimeT::getTicks();
+        for (uint8_t i = 0; i < MaxTasks; i++)
+        {
+            if (_heartbeat[i] > 0 && now - _lastRun[i] > _heartbeat[i])
+            {
+                _offender = i;
+                return;
+            }
+        }
+
+        wdt_reset();
+    }
+
+    /** Call this method from the `ISR(WDT_vect)` interrupt handler.
+     *  Not meant to be called from regular code. Does not return.
+     */
+    static void OnWatchdogInterrupt()
+    {
+        if (_safeStop != nullptr)
+            _safeStop();
+
+        taskWatchdogResetInfo.TaskId = _offender != NoTaskId ? _offender : _current;
+        taskWatchdogResetInfo.Magic = TaskWatchdogResetInfo::MagicValue;
+
+        // reset as soon as possible
+        WDTCSR = (1 << WDCE) | (1 << WDE);
+        WDTCSR = (1 << WDE);
+        while (true)
+        {
+        }
+    }
+
+private:
+    // milliseconds of CounterT
+    static uint16_t _maxExecution[MaxTasks];
+    static uint16_t _heartbeat[MaxTasks];
+    static uint32_t _lastRun[MaxTasks];
+    static uint32_t _taskStart;
+    static volatile uint8_t _current;
+    static volatile uint8_t _offender;
+    static SafeStopFunction _safeStop;
+
+    TaskWatchdog() {}
+};
+
+template <class TimeT, class CounterT, const uint8_t MaxTasks>
+uint16_t TaskWatchdog<TimeT, CounterT, MaxTasks>::_maxExecution[] = {};
+template <class TimeT, class CounterT, const uint8_t MaxTasks>
+uint16_t TaskWatchdog<TimeT, CounterT, MaxTasks>::_heartbeat[] = {};
+template <class TimeT, class CounterT, const uint8_t MaxTasks>
+uint32_t TaskWatchdog<TimeT, CounterT, MaxTasks>::_lastRun[] = {};
+template <class TimeT, class CounterT, const uint8_t MaxTasks>
+uint32_t TaskWatchdog<TimeT, CounterT, MaxTasks>::_taskStart = 0;
+template <class TimeT, class CounterT, const uint8_t MaxTasks>
+volatile uint8_t TaskWatchdog<TimeT, CounterT, MaxTasks>::_current = TaskWatchdog<TimeT, CounterT, MaxTasks>::NoTaskId;
+template <class TimeT, class CounterT, const uint8_t MaxTasks>
+volatile uint8_t TaskWatchdog<TimeT, CounterT, MaxTasks>::_offender = TaskWatchdog<TimeT, CounterT, MaxTasks>::NoTaskId;
+template <class TimeT, class CounterT, const uint8_t MaxTasks>
+typename TaskWatchdog<TimeT, CounterT, MaxTasks>::SafeStopFunction TaskWatchdog<TimeT, CounterT, MaxTasks>::_safeStop = nullptr;
@@ -2,12 +2,14 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include "atl/LockScope.h"
+#include "atl/AtlMath.h"
 #include "TimeResolution.h"
 #include "PowerReduction.h"
 
 #ifdef TCNT0
 
 // This class is a quick implementation taken from Arduino. Uses Timer0.
+// The counters are read lock-free: a read is repeated when the overflow interrupt changed them.
 class TimerCounter0
 {
 // FROM ARDUINO
@@ -26,6 +28,10 @@ class TimerCounter0
 #define Timer0_Fract_Inc ((Microseconds_Per_Timer0_Overflow % 1000) >> 3)
 #define Timer0_Fract_Max (1000 >> 3)
 
+    // microseconds per timer tick (4 at 16MHz). a power of two is converted with a shift.
+    static const uint32_t MicrosecondsPerTick = 64 / (F_CPU / 1000000L);
+    static_assert(MicrosecondsPerTick > 0, "F_CPU is too high for Timer0 with prescaler 64.");
+
 public:
     static void Start()
     {
@@ -48,26 +54,52 @@ public:
 
     static uint32_t getMilliseconds()
     {
-        LockScope lock;
-        return _milliCount;
+        uint32_t millis;
+        do
+        {
+            millis = _milliCount;
+        } while (millis != _milliCount);
+
+        return millis;
     }
 
-    static uint32_t getMicroseconds()
+    /** Returns the milliseconds since Start in 64-bit (does not wrap after 49 days).
+     */
+    static uint64_t getMilliseconds64()
     {
-        uint32_t micros;
-        uint8_t count;
-
+        uint32_t millis;
+        uint16_t epoch;
+        do
         {
-            LockScope lock;
+            epoch = _milliEpoch;
+            millis = _milliCount;
+        } while (epoch != _milliEpoch || millis != _milliCount);
 
-            micros = _overflowCount;
-            count = TCNT0;
+        return ((uint64_t)epoch << 32) | millis;
+    }
 
-            if ((TIFR0 & (1 << TOV0)) && (count < 255))
-                micros++;
-        }
+    static uint32_t getMicroseconds()
+    {
+        return TicksToMicroseconds(getTicks());
+    }
 
-        return ((micros << 8) + count) * (64 / (F_CPU / 1000000L));
+    /** Returns the microseconds since Start in 64-bit (does not wrap after 71 minutes).
+     */
+    static uint64_t getMicroseconds64()
+    {
+        uint16_t epoch;
+        uint32_t ticks = ReadTicks(&epoch);
+
+        return TicksToMicroseconds(((uint64_t)epoch << 32) | ticks);
+    }
+
+    /** Returns the raw timer ticks (overflows * 256 + TCNT0) since Start.
+     *  Interrupts stay enabled: the read repeats if an overflow interrupt happened in between.
+     */
+    static uint32_t getTicks()
+    {
+        uint16_t epoch;
+        return ReadTicks(&epoch);
     }
 
     // Call from ISR(TIMER0_OVF_vect)
@@ -86,16 +118,54 @@ public:
             millis += 1;
         }
 
+        if (millis < _milliCount)
+            _milliEpoch++;
         _milliCount = millis;
         _fractureCount = (uint8_t)fract;
-        _overflowCount++;
+        // ticks wrap when the top 8 bits of the overflow count wrap
+        if ((++_overflowCount & 0x00FFFFFF) == 0)
+            _tickEpoch++;
     }
 
 private:
     TimerCounter0() {}
+
+    // reads the ticks and their epoch as one.
+    // a pending overflow is counted the same way as the ISR does, including the epoch carry.
+    static uint32_t ReadTicks(uint16_t *outEpoch)
+    {
+        uint32_t overflows;
+        uint16_t epoch;
+        uint8_t count;
+        bool pending;
+        do
+        {
+            epoch = _tickEpoch;
+            overflows = _overflowCount;
+            count = TCNT0;
+            // overflowed, but the interrupt has not run yet (interrupts disabled by the caller)
+            pending = (TIFR0 & (1 << TOV0)) && (count < 255);
+        } while (overflows != _overflowCount || epoch != _tickEpoch);
+
+        if (pending && (++overflows & 0x00FFFFFF) == 0)
+            epoch++;
+
+        *outEpoch = epoch;
+        return (overflows << 8) + count;
+    }
     static volatile uint32_t _milliCount;
     static volatile uint32_t _overflowCount;
+    static volatile uint16_t _milliEpoch;
+    static volatile uint16_t _tickEpoch;
     static uint8_t _fractureCount; // not volatile, only accessed from within ISR
+
+    template <typename T>
+    static T TicksToMicroseconds(T ticks)
+    {
+        if (Math::IsPowerOfTwo(MicrosecondsPerTick))
+            return ticks << Math::Log2(MicrosecondsPerTick);
+        return ticks * MicrosecondsPerTick;
+    }
 };
 
 template <>
@@ -112,6 +182,8 @@ uint32_t TimerCounter0::getTime<TimeResolution::Milliseconds>()
 
 volatile uint32_t TimerCounter0::_milliCount;
 volatile uint32_t TimerCounter0::_overflowCount;
+volatile uint16_t TimerCounter0::_milliEpoch;
+volatile uint16_t TimerCounter0::_tickEpoch;
 uint8_t TimerCounter0::_fractureCount;
 
 // ISR(TIMER0_OVF_vect)
@@ -234,6 +306,85 @@ uint16_t TimerCounter1::_fractureCount;
 //     TimerCounter1::OnTimerOverflowInterrupt();
 // }
 
+/** The FreeRunningTimer1 runs Timer1 free at clock/8 (0.5us per tick at 16MHz) in normal mode.
+ *  The overflow interrupt extends the 16-bit counter to 32-bit ticks (wraps after ~35 minutes).
+ *  The compare units (OCR1A/OCR1B) are free for one-shot timers (OneShotTimer.h).
+ *  Use either TimerCounter1 or FreeRunningTimer1, not both.
+ */
+class FreeRunningTimer1
+{
+public:
+    static const uint32_t TicksPerMicrosecond = F_CPU / 8000000L;
+
+    /** Starts the timer. Calling it again does not reset the counter.
+     */
+    static void Start()
+    {
+        if (getIsRunning())
+            return;
+
+        PowerReduction::Timer1(PowerState::On);
+
+        // normal mode: count up to 0xFFFF and wrap
+        TCCR1A = 0;
+        TCNT1 = 0;
+        // prescaler to 8
+        TCCR1B = (1 << CS11);
+        // clear any pending overflow interrupts
+        TIFR1 = (1 << TOV1);
+        TIMSK1 |= (1 << TOIE1);
+    }
+
+    static bool getIsRunning()
+    {
+        return (TCCR1B & ((1 << CS12) | (1 << CS11) | (1 << CS10))) != 0;
+    }
+
+    /** Returns the 32-bit tick count.
+     */
+    static uint32_t getTicks()
+    {
+        LockScope lock;
+        return getTicksLocked();
+    }
+
+    /** Returns the 32-bit tick count. Interrupts must be disabled (ISR).
+     */
+    static uint32_t getTicksLocked()
+    {
+        uint16_t overflows = _overflowCount;
+        uint16_t count = TCNT1;
+
+        // the overflow interrupt is pending
+        if ((TIFR1 & (1 << TOV1)) && (count < 0x8000))
+            overflows++;
+
+        return ((uint32_t)overflows << 16) | count;
+    }
+
+    static uint32_t TicksToMicroseconds(uint32_t ticks)
+    {
+        return ticks / TicksPerMicrosecond;
+    }
+
+    static uint32_t MicrosecondsToTicks(uint32_t microseconds)
+    {
+        return microseconds * TicksPerMicrosecond;
+    }
+
+    // Call from ISR(TIMER1_OVF_vect)
+    static void OnTimerOverflowInterrupt()
+    {
+        _overflowCount++;
+    }
+
+private:
+    FreeRunningTimer1() {}
+    static volatile uint16_t _overflowCount;
+};
+
+volatile uint16_t FreeRunningTimer1::_overflowCount;
+
 #endif // TCNT1
 
 // ----------------------------------------------------------------------------
@@ -112,9 +112,9 @@ public:
     static TwiResult Start(uint8_t address, bool read)
     {
         if (read)
-            Trace("Start (read)");
+            Trace(DebugLog_Id("Start (read) address={}"), address);
         else
-            Trace("Start (write)");
+            Trace(DebugLog_Id("Start (write) address={}"), address);
 
         if (!IsValidAddress(address))
             return TwiResult::InvalidParameter;
@@ -142,7 +142,7 @@ public:
     // Send STOP condition
     static TwiResult Stop(uint32_t spinTimeout = 500)
     {
-        Trace("Stop");
+        Trace(DebugLog_Id("Stop"));
         // Transmit STOP condition
         TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWSTO);
 
@@ -159,7 +159,7 @@ public:
     // Send data byte
     static TwiResult Write(uint8_t data)
     {
-        Trace("Write");
+        Trace(DebugLog_Id("Write {}"), data);
         if (!Send(data))
             return TwiResult::Timeout;
 
@@ -173,7 +173,7 @@ public:
     // Read data byte with ACK (more bytes to follow)
     static bool TryReadAck(uint8_t *outData)
     {
-        Trace("TryReadAck");
+        Trace(DebugLog_Id("TryReadAck"));
         // Signal acknowledgment after reception
         TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWEA);
         if (!WaitForComplete())
@@ -187,7 +187,7 @@ public:
     // Read data byte with NACK (last byte)
     static bool TryReadNack(uint8_t *outData)
     {
-        Trace("TryReadNack");
+        Trace(DebugLog_Id("TryReadNack"));
         // Signal no acknowledgment after reception
         TWCR = (1 << TWINT) | (1 << TWEN);
         if (!WaitForComplete())
@@ -249,12 +249,13 @@ private:
     }
 
 #ifdef DEBUG
-    static void Trace(const char *msg)
+    // tokenized: queuing the id does not slow down the bus
+    static void Trace(uint16_t messageId, int16_t arg = 0)
     {
-        LogTrace<DebugComponentId>(msg);
+        LogTrace<DebugComponentId>(messageId, arg);
     }
 #else
-    static void Trace(const char *msg) {}
+    static void Trace(uint16_t messageId, int16_t arg = 0) {}
 #endif //~DEBUG
 };
 
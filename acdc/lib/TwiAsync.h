@@ -0,0 +1,227 @@
+#pragma once
+#include <stdint.h>
+#include <avr/io.h>
+#include "atl/Completion.h"
+#include "atl/LockScope.h"
+#include "atl/RingBuffer.h"
+#include "Twi.h"
+
+/** A TwiTransaction describes one I2C master transaction:
+ *  an optional write phase followed by an optional (repeated start) read phase.
+ *  The transaction and its buffers are owned by the caller and must stay alive until it is complete.
+ */
+struct TwiTransaction
+{
+    uint8_t Address;
+    const uint8_t *WriteData;
+    uint8_t WriteLength;
+    uint8_t *ReadData;
+    uint8_t ReadLength;
+    Completion *Done;
+};
+
+/** The TwiAsync runs queued I2C transactions from the TWI interrupt.
+ *  Each transaction completes its Completion with a TwiResult (cast to uint8_t) and
+ *  the ReadData as data pointer. The next queued transaction starts with a repeated STOP/START
+ *  from the same interrupt, so a sequence of transactions never waits for the main loop.
+ *  Do not use the blocking Twi methods while transactions are queued.
+ *  Call `Twi::Open()` first and implement `ISR(TWI_vect)` to call `OnTwiInterrupt()`.
+ *  TwiAsync is a static class and cannot be instantiated.
+ */
+class TwiAsync
+{
+    static const uint8_t QueueSize = 4;
+
+public:
+    /** Queues the transaction (from the main loop only: the queue has a single producer).
+     *  \param transaction is the transaction to execute.
+     *  \return Returns false if the queue is full, the completion is pending or the address is invalid.
+     */
+    static bool Enqueue(TwiTransaction *transaction)
+    {
+        if (!Twi::IsValidAddress(transaction->Address) ||
+            !transaction->Done->TryStart())
+            return false;
+
+        // the queue is lock-free: only starting an idle bus needs the interrupt off
+        if (!_queue.Write(transaction))
+        {
+            transaction->Done->Reset();
+            return false;
+        }
+
+        LockScope lock;
+        if (_current == nullptr)
+            StartNext(false);
+        return true;
+    }
+
+    /** Queues a write transaction.
+     *  \param address is the 7-bit device address.
+     *  \param data is the data to write (including the register).
+     *  \param length is the number of bytes to write.
+     *  \param transaction is (caller owned) storage for the transaction.
+     *  \param completion is completed when done.
+     *  \return Returns false if the transaction was not queued.
+     */
+    static bool Write(uint8_t address, const uint8_t *data, uint8_t length, TwiTransaction *transaction, Completion *completion)
+    {
+        transaction->Address = address;
+        transaction->WriteData = data;
+        transaction->WriteLength = length;
+        transaction->ReadData = nullptr;
+        transaction->ReadLength = 0;
+        transaction->Done = completion;
+        return Enqueue(transaction);
+    }
+
+    /** Queues a register read transaction (write register, repeated start, read).
+     *  \param address is the 7-bit device address.
+     *  \param reg is the (caller owned) register byte to write first.
+     *  \param outData receives the data read.
+     *  \param length is the number of bytes to read.
+     *  \param transaction is (caller owned) storage for the transaction.
+     *  \param completion is completed when done.
+     *  \return Returns false if the transaction was not queued.
+     */
+    static bool ReadRegister(uint8_t address, const uint8_t *reg, uint8_t *outData, uint8_t length, TwiTransaction *transaction, Completion *completion)
+    {
+        transaction->Address = address;
+        transaction->WriteData = reg;
+        transaction->WriteLength = 1;
+        transaction->ReadData = outData;
+        transaction->ReadLength = length;
+        transaction->Done = completion;
+        return Enqueue(transaction);
+    }
+
+    static bool getIsBusy()
+    {
+        return _current != nullptr;
+    }
+
+    /** Call this method from the `ISR(TWI_vect)` interrupt handler.
+     *  Not meant to be called from regular code.
+     */
+    static void OnTwiInterrupt()
+    {
+        TwiTransaction *transaction = _current;
+        if (transaction == nullptr)
+        {
+            // not ours: just clear the interrupt
+            TWCR = (1 << TWINT) | (1 << TWEN);
+            return;
+        }
+
+        switch (TWSR & TWI_STATUS_MASK)
+        {
+        case TWI_STATUS_START_SUCCESS:
+        case TWI_STATUS_REPEATED_START:
+            if (!_reading && transaction->WriteLength > 0)
+                TWDR = transaction->Address << 1;
+            else
+            {
+                _reading = true;
+                TWDR = (transaction->Address << 1) | 1;
+            }
+            _index = 0;
+            Continue(false);
+            break;
+
+        case TWI_STATUS_SLA_W_ACK:
+        case TWI_STATUS_DATA_TX_ACK:
+            if (_index < transaction->WriteLength)
+            {
+                TWDR = transaction->WriteData[_index++];
+                Continue(false);
+            }
+            else if (transaction->ReadLength > 0)
+            {
+                _reading = true;
+                TWCR = (1 << TWINT) | (1 << TWSTA) | (1 << TWEN) | (1 << TWIE);
+            }
+            else
+                Finish(TwiResult::Ok);
+            break;
+
+        case TWI_STATUS_SLA_R_ACK:
+            // acknowledge unless only one byte is to be read
+            Continue(transaction->ReadLength > 1);
+            break;
+
+        case TWI_STATUS_DATA_RX_ACK:
+            transaction->ReadData[_index++] = TWDR;
+            Continue(_index + 1 < transaction->ReadLength);
+            break;
+
+        case TWI_STATUS_DATA_RX_NACK:
+            transaction->ReadData[_index++] = TWDR;
+            Finish(TwiResult::Ok);
+            break;
+
+        case TWI_STATUS_SLA_W_NACK:
+        case TWI_STATUS_SLA_R_NACK:
+            Finish(TwiResult::AddressFailed);
+            break;
+
+        case TWI_STATUS_DATA_TX_NACK:
+            Finish(TwiResult::DataFailed);
+            break;
+
+        default:
+            // arbitration lost or bus error
+            Finish(_reading ? TwiResult::StartReadFailed : TwiResult::StartWriteFailed);
+            break;
+        }
+    }
+
+private:
+    static RingBufferSpsc<TwiTransaction *, QueueSize> _queue;
+    static TwiTransaction *volatile _current;
+    static uint8_t _index;
+    static bool _reading;
+
+    static void Continue(bool acknowledge)
+    {
+        TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWIE) | (acknowledge ? (1 << TWEA) : 0);
+    }
+
+    static void Finish(TwiResult result)
+    {
+        TwiTransaction *transaction = _current;
+        transaction->Done->Complete((uint8_t)result, transaction->ReadData);
+        StartNext(true);
+    }
+
+    // interrupts are disabled (ISR or LockScope)
+    static void StartNext(bool stop)
+    {
+        _reading = false;
+        _index = 0;
+
+        TwiTransaction *next;
+        if (!_queue.TryRead(&next))
+        {
+            _current = nullptr;
+            if (stop)
+                TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWSTO);
+            return;
+        }
+
+        _current = next;
+        // STOP followed by START when both are set
+        TWCR = (1 << TWINT) | (1 << TWSTA) | (1 << TWEN) | (1 << TWIE) | (stop ? (1 << TWSTO) : 0);
+    }
+
+    TwiAsync() {}
+};
+
+RingBufferSpsc<TwiTransaction *, TwiAsync::QueueSize> TwiAsync::_queue;
+TwiTransaction *volatile TwiAsync::_current = nullptr;
+uint8_t TwiAsync::_index = 0;
+bool TwiAsync::_reading = false;
+
+// ISR(TWI_vect)
+// {
+//     TwiAsync::OnTwiInterrupt();
+// }
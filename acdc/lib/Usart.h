@@ -1,6 +1,7 @@
 #pragma once
 #include <stdint.h>
 #include <avr/io.h>
+#include "PowerReduction.h"
 #include "UsartConfig.h"
 #include "UsartTransmit.h"
 #include "UsartReceive.h"
@@ -17,9 +18,6 @@ template <const UsartIds UsartId,
           typename ReceiveT = UsartReceive<UsartId>>
 class Usart
 {
-    // TODO: support other usart ids
-    static_assert(UsartId == UsartIds::Usart0, "Only Usart0 is supported");
-
 public:
     /** Gets the UsartId this instance represents.
      *  Returns the UsartId template parameter.
@@ -47,7 +45,7 @@ public:
             return false;
         }
 
-        PowerReduction::Usart0(PowerState::On);
+        setPower(PowerState::On);
 
         UsartRegisters<UsartId>::getUBRR() = config.getUBRR();
         UsartRegisters<UsartId>::getUCSRA() = config.getUCSRA();
@@ -64,7 +62,7 @@ public:
     {
         Receive.Close();
         Transmit.Close();
-        PowerReduction::Usart0(PowerState::Off);
+        setPower(PowerState::Off);
     }
 
     /** The instance of the Transmit class.
@@ -74,4 +72,30 @@ public:
     /** The instance of the Receive class.
      */
     ReceiveT Receive;
+
+private:
+    static void setPower(PowerState state)
+    {
+        switch (UsartId)
+        {
+#ifdef UBRR1
+        case UsartIds::Usart1:
+            PowerReduction::Usart1(state);
+            break;
+#endif
+#ifdef UBRR2
+        case UsartIds::Usart2:
+            PowerReduction::Usart2(state);
+            break;
+#endif
+#ifdef UBRR3
+        case UsartIds::Usart3:
+            PowerReduction::Usart3(state);
+            break;
+#endif
+        default:
+            PowerReduction::Usart0(state);
+            break;
+        }
+    }
 };
\ No newline at end of file
@@ -77,6 +77,12 @@ class UsartConfig
 #define DIV_ASYNC 16
 
 public:
+    /** The default maximum baud rate error in 0.1% (2.5%).
+     *  Two devices that both deviate this much (in opposite directions) can still communicate with 8 data bits.
+     *  (115200 at 16MHz is 2.1% off.)
+     */
+    static const uint8_t DefaultMaxBaudErrorPermille = 25;
+
     /** Constructs a new instance.
      *  Default: 8 data bits, no parity and one stop bit.
      */
@@ -88,52 +94,61 @@ public:
 
     /** Initializes an Asynchronous mode using the baudRate.
      *  The configured baud rate can deviate from the specified baudRate.
-     *  The method will choose between normal and double speed Async mode based on the smallest deviation of the baud rate.
+     *  The method computes the (rounded) UBRR for both normal and double speed (U2X) Async mode
+     *  and chooses the one with the smallest deviation of the baud rate (normal speed on a tie:
+     *  it samples each bit more often).
      *  \param baudRate is the target baud rate to configure. Final configured value may deviate.
-     *  \return Returns true when successful.
+     *  \param maxErrorPermille is the maximum deviation (in 0.1%) that is accepted.
+     *  \return Returns false when no mode is within the maximum deviation (the config is cleared).
      */
-    bool InitAsync(uint32_t baudRate)
+    bool InitAsync(uint32_t baudRate, uint8_t maxErrorPermille = DefaultMaxBaudErrorPermille)
     {
-        int16_t ubrr8 = CalcUBRR(8, baudRate);
-        int16_t ubrr16 = CalcUBRR(16, baudRate);
-
-        // if one (or both) are invalid the other (or none) is correct
-        if (!isValidUBRR(ubrr8) || !isValidUBRR(ubrr16))
-        {
-            if (isValidUBRR(ubrr16))
-            {
-                _clockDivider = DIV_ASYNC;
-                _ubrr = ubrr16;
-                return true;
-            }
-
-            if (isValidUBRR(ubrr8))
-            {
-                _clockDivider = DIV_ASYNC2SPEED;
-                _ubrr = ubrr8;
-                return true;
-            }
-
-            ClearBaudRate();
+        ClearBaudRate();
+        if (baudRate == 0)
             return false;
-        }
 
-        // if both divider-rates are valid, pick the one with the lowest deviation
-        int16_t delta8 = Math::Abs<int16_t>(baudRate - CalcBaudRate(DIV_ASYNC2SPEED, ubrr8));
-        int16_t delta16 = Math::Abs<int16_t>(baudRate - CalcBaudRate(DIV_ASYNC, ubrr16));
+        uint16_t ubrr16 = 0;
+        uint16_t ubrr8 = 0;
+        uint16_t error16 = CalcErrorPermille(DIV_ASYNC, baudRate, &ubrr16);
+        uint16_t error8 = CalcErrorPermille(DIV_ASYNC2SPEED, baudRate, &ubrr8);
 
-        if (delta16 > delta8)
+        if (error16 <= error8)
         {
+            if (error16 > maxErrorPermille)
+                return false;
+            _clockDivider = DIV_ASYNC;
+            _ubrr = ubrr16;
+            _errorPermille = error16;
+        }
+        else
+        {
+            if (error8 > maxErrorPermille)
+                return false;
             _clockDivider = DIV_ASYNC2SPEED;
             _ubrr = ubrr8;
-            return true;
+            _errorPermille = error8;
         }
-
-        _clockDivider = DIV_ASYNC;
-        _ubrr = ubrr16;
         return true;
     }
 
+    /** Retrieves the actual baud rate that is configured.
+     *  \return Returns 0 if no baud rate is configured.
+     */
+    uint32_t getBaudRate() const
+    {
+        if (_clockDivider == 0)
+            return 0;
+        return CalcBaudRate(_clockDivider, _ubrr);
+    }
+
+    /** Retrieves the deviation of the configured baud rate from the requested baud rate.
+     *  \return Returns the deviation in 0.1%.
+     */
+    uint16_t getBaudErrorPermille() const
+    {
+        return _errorPermille;
+    }
+
     /** Retrieves the configured mode.
      *  (Currently only Async modes are implemented).
      *  \return Returns Invalid if the InitAsync method was not called.
@@ -280,8 +295,9 @@ public:
         }
         else
         {
-            // Bits9 = UCSZ00=1, UCSZ01=1
+            // Bits9 = UCSZ00=1, UCSZ01=1 (and UCSZ02=1 in UCSRB)
             Bit<UCSZ00>::Set(ucsrc);
+            Bit<UCSZ01>::Set(ucsrc);
         }
 
         // UCPOL (sync clock polarity)
@@ -292,24 +308,42 @@ public:
 private:
     uint8_t _clockDivider;
     uint16_t _ubrr;
+    uint16_t _errorPermille = 0;
     UsartDataBits _dataBits;
     UsartParity _parity;
     UsartStopBits _stopBits;
 
-    // TODO: ((F_CPU + UART_BAUD_RATE * 8L) / (UART_BAUD_RATE * 16L) - 1)
-    // ubrr = (fOsc / ([16,8,2] * baudRate)) - 1
-    static int16_t CalcUBRR(uint8_t clockDivider, uint32_t baudRate)
+    // ubrr = (fOsc / ([16,8,2] * baudRate)) - 1 (rounded)
+    static int32_t CalcUBRR(uint8_t clockDivider, uint32_t baudRate)
     {
-        return (int16_t)((F_CPU / ((int32_t)clockDivider * baudRate)) - 1);
+        uint32_t divisor = (uint32_t)clockDivider * baudRate;
+        return (int32_t)((F_CPU + divisor / 2) / divisor) - 1;
     }
 
     // baudRate = fOsc / ([16,8,2] * (ubrr + 1))
-    static int16_t CalcBaudRate(uint8_t clockDivider, uint16_t ubrr)
+    static uint32_t CalcBaudRate(uint8_t clockDivider, uint16_t ubrr)
+    {
+        return F_CPU / ((uint32_t)clockDivider * (ubrr + 1));
+    }
+
+    // returns the deviation in 0.1% (0xFFFF when the rate cannot be made)
+    static uint16_t CalcErrorPermille(uint8_t clockDivider, uint32_t baudRate, uint16_t *outUbrr)
     {
-        return (int16_t)(F_CPU / ((int32_t)clockDivider * (int32_t)(ubrr + 1)));
+        int32_t ubrr = CalcUBRR(clockDivider, baudRate);
+        if (!isValidUBRR(ubrr))
+            return 0xFFFF;
+
+        uint32_t actual = CalcBaudRate(clockDivider, ubrr);
+        uint32_t delta = actual > baudRate ? actual - baudRate : baudRate - actual;
+        if (delta >= baudRate)
+            return 0xFFFF;
+
+        *outUbrr = ubrr;
+        // delta < baudRate (max 2M): fits in 32 bits
+        return (delta * 1000 + baudRate / 2) / baudRate;
     }
 
-    static bool isValidUBRR(int16_t ubrr)
+    static bool isValidUBRR(int32_t ubrr)
     {
         return (ubrr < MAX_UBBR && ubrr >= 0);
     }
@@ -318,5 +352,6 @@ private:
     {
         _clockDivider = 0;
         _ubrr = 0;
+        _errorPermille = 0;
     }
 };
\ No newline at end of file
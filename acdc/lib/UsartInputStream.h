@@ -1,7 +1,11 @@
 #pragma once
+#include <stdint.h>
+#include "atl/LockScope.h"
 
 /** The UsartInputStream can be constructed around the UsartReceive class
  *  to add buffered and interrupt based data reception.
+ *  Receive errors are counted (see `getErrorCounts()`): bytes with a frame or parity error are dropped,
+ *  a byte with a data overrun is kept (the byte before it was lost).
  *  \tparam BaseT is used as base class and is the UsartReceive class and implements
  *  `void Clear()`
  *  `void setEnableIsCompleteInterrupt(bool)`
@@ -75,16 +79,61 @@ public:
         return false;
     }
 
+    /** The receive error counters (saturate at 0xFFFF).
+     */
+    struct ErrorCounts
+    {
+        /** Bytes dropped on a frame error (wrong baud rate, noise, break). */
+        uint16_t FrameErrors;
+        /** Bytes dropped on a parity error. */
+        uint16_t ParityErrors;
+        /** Bytes lost because the interrupt did not read the data register in time. */
+        uint16_t OverRuns;
+        /** Bytes dropped because the buffer was full. */
+        uint16_t BufferOverflows;
+    };
+
+    /** Retrieves a snapshot of the receive error counters.
+     *  \return Returns the counts since the last `ResetErrorCounts()`.
+     */
+    ErrorCounts getErrorCounts() const
+    {
+        LockScope lock;
+        return _errors;
+    }
+
+    void ResetErrorCounts()
+    {
+        LockScope lock;
+        _errors = ErrorCounts();
+    }
+
     /** Call this method from the `ISR(USARTn_RX_vect)` interrupt handler.
      *  Not meant to be called from regular code.
      */
     void OnIsCompleteInterrupt()
     {
-        UsartReceiveResult result = BaseT::getResult();
-        int16_t data = BaseT::ReadInternal();
+        int16_t data;
+        if (TryReceive(&data))
+            Store(data);
+    }
+
+    /** Call this method from the `ISR(USARTn_RX_vect)` interrupt handler.
+     *  Not meant to be called from regular code.
+     *  The reservedByte is not stored in the buffer but reported back immediately.
+     *  \param reservedByte is the value that is handled by the caller.
+     *  \return Returns true if the reservedByte was received.
+     */
+    bool OnIsCompleteInterrupt(uint8_t reservedByte)
+    {
+        int16_t data;
+        if (!TryReceive(&data))
+            return false;
+        if (data == reservedByte)
+            return true;
 
-        if (result == UsartReceiveResult::Success)
-            _buffer.Write((typename BufferT::ItemT)data);
+        Store(data);
+        return false;
     }
 
     /** Retrieves the buffer size used for storing received data.
@@ -106,4 +155,40 @@ public:
 
 private:
     BufferT _buffer;
+    ErrorCounts _errors = ErrorCounts();
+
+    // reads the data register and counts the error (if any). returns false if the data is invalid.
+    bool TryReceive(int16_t *outData)
+    {
+        UsartReceiveResult result = BaseT::getResult();
+        *outData = BaseT::ReadInternal();
+
+        switch (result)
+        {
+        case UsartReceiveResult::Success:
+            return true;
+        case UsartReceiveResult::DataOverRun:
+            // the data itself is valid
+            Count(_errors.OverRuns);
+            return true;
+        case UsartReceiveResult::ParityError:
+            Count(_errors.ParityErrors);
+            return false;
+        default:
+            Count(_errors.FrameErrors);
+            return false;
+        }
+    }
+
+    void Store(int16_t data)
+    {
+        if (!_buffer.Write((typename BufferT::ItemT)data))
+            Count(_errors.BufferOverflows);
+    }
+
+    static void Count(uint16_t &counter)
+    {
+        if (counter < 0xFFFF)
+            counter++;
+    }
 };
\ No newline at end of file
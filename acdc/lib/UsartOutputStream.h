@@ -1,8 +1,25 @@
 #pragma once
 #include <stdint.h>
+#include "atl/LockScope.h"
+#include "atl/SpinWait.h"
+
+/** Determines what `UsartOutputStream::Write()` does when the buffer is full.
+ */
+enum class UsartWritePolicy : uint8_t
+{
+    /** Waits until the interrupt has sent a byte (the caller depends on the baud rate). */
+    Block,
+    /** Drops the byte that is written (the oldest data is sent intact). */
+    DropNewest,
+    /** Drops the oldest byte in the buffer to make room (the latest data is sent). */
+    DropOldest,
+};
 
 /** The UsartOutputStream can be constructed around the UsartTransmist class
  *  to add buffered and interrupt based data transmission.
+ *  The accept data (UDRE) interrupt is only enabled while there is data in the buffer.
+ *  What happens when the buffer is full is determined by the UsartWritePolicy (default Block).
+ *  `TryWrite()` never waits and never drops buffered data.
  *  \tparam BaseT is used as base class and is the UsartTransmit class and implements
  *  `void Flush()`
  *  `void setEnableWantDataInterrupt(bool)`
@@ -36,7 +53,7 @@ public:
      */
     void Flush()
     {
-        _buffer.Clear();
+        Clear();
         BaseT::Flush();
     }
 
@@ -46,13 +63,87 @@ public:
     }
 
     /** Writes one byte to the stream.
+     *  When the buffer is full the UsartWritePolicy determines what happens.
      *  \param data the byte that is written to the output stream.
      */
     void Write(uint8_t data)
     {
-        // keep retrying till the buffer has space
-        while (!_buffer.Write(data))
-            SpinWait(1);
+        if (TryWrite(data))
+            return;
+
+        switch (_policy)
+        {
+        case UsartWritePolicy::DropNewest:
+            Drop();
+            break;
+        case UsartWritePolicy::DropOldest:
+        {
+            LockScope lock;
+            // the interrupt may have made room in the meantime
+            if (_buffer.getCount() >= _buffer.getCapacity())
+            {
+                _buffer.Read();
+                Drop();
+            }
+            _buffer.Write(data);
+            break;
+        }
+        default:
+            // keep retrying till the buffer has space
+            while (!TryWrite(data))
+                SpinWait(1);
+            break;
+        }
+    }
+
+    /** Writes one byte to the stream if there is room. Never waits.
+     *  \param data the byte that is written to the output stream.
+     *  \return Returns false if the buffer is full; the byte is not written (and not counted as dropped).
+     */
+    bool TryWrite(uint8_t data)
+    {
+        if (!_buffer.Write(data))
+            return false;
+
+        uint8_t count = _buffer.getCount();
+        if (count > _highWatermark)
+            _highWatermark = count;
+
+        BaseT::setEnableAcceptDataInterrupt(true);
+        return true;
+    }
+
+    void setWritePolicy(UsartWritePolicy policy)
+    {
+        _policy = policy;
+    }
+
+    UsartWritePolicy getWritePolicy() const
+    {
+        return _policy;
+    }
+
+    /** Returns the number of bytes dropped by the write policy.
+     */
+    uint16_t getDroppedCount() const
+    {
+        return _droppedCount;
+    }
+
+    /** Returns the highest number of bytes that were in the buffer.
+     *  Equal to `getBufferSize()` means the buffer has been full.
+     */
+    uint8_t getHighWatermark() const
+    {
+        return _highWatermark;
+    }
+
+    /** Resets the dropped count and the high watermark.
+     */
+    void ResetStatistics()
+    {
+        _droppedCount = 0;
+        _highWatermark = 0;
     }
 
     /** Call this method from the `ISR(USARTn_UDRE_vect)` interrupt handler.
@@ -65,6 +156,11 @@ public:
             // write the next byte from buffer
             BaseT::WriteInternal(_buffer.Read());
         }
+        else
+        {
+            // nothing to send: the interrupt would fire continuously
+            BaseT::setEnableAcceptDataInterrupt(false);
+        }
     }
 
     /** Retrieves the buffer size used for storing transmit data.
@@ -80,10 +176,27 @@ public:
      */
     void Close()
     {
-        _buffer.Clear();
+        Clear();
         BaseT::Close();
     }
 
 private:
     BufferT _buffer;
+    UsartWritePolicy _policy = UsartWritePolicy::Block;
+    uint16_t _droppedCount = 0;
+    uint8_t _highWatermark = 0;
+
+    // the buffer is read by the UDRE interrupt: stop it before the (consumer side) clear
+    void Clear()
+    {
+        LockScope lock;
+        BaseT::setEnableAcceptDataInterrupt(false);
+        _buffer.Clear();
+    }
+
+    void Drop()
+    {
+        if (_droppedCount < 0xFFFF)
+            _droppedCount++;
+    }
 };
\ No newline at end of file
@@ -9,14 +9,20 @@ enum class UsartIds
 {
 /** Usart 0 */
 #ifdef UBRR0
-    Usart0,
+    Usart0 = 0,
 #endif
-/** Usart 1 */
+/** Usart 1 (ATmega2560) */
 #ifdef UBRR1
-    Usart1
+    Usart1 = 1,
+#endif
+/** Usart 2 (ATmega2560) */
+#ifdef UBRR2
+    Usart2 = 2,
+#endif
+/** Usart 3 (ATmega2560) */
+#ifdef UBRR3
+    Usart3 = 3,
 #endif
-    // Usart2,
-    // Usart3,
 };
 
 /** The UsartRegisters class is a static class (that cannot be instantiated)
@@ -26,13 +32,16 @@ enum class UsartIds
 template <const UsartIds UsartId>
 class UsartRegisters
 {
+    // the registers of Usart 0-2 are 8 bytes apart, Usart 3 is in the extended I/O space
+    static const uint16_t Base = (uint8_t)UsartId == 3 ? 0x130 : 0xC0 + ((uint8_t)UsartId * 0x08);
+
 public:
     /** Usart Baud Rate Register
      *  \return Returns a reference to the register.
      */
     static volatile uint16_t &getUBRR()
     {
-        return _SFR_MEM16(0xC4 + ((uint8_t)UsartId * 0x08));
+        return _SFR_MEM16(Base + 0x04);
     }
 
     /** Usart Control and Status Register A
@@ -40,7 +49,7 @@ public:
      */
     static volatile uint8_t &getUCSRA()
     {
-        return _SFR_MEM8(0xC0 + ((uint8_t)UsartId * 0x08));
+        return _SFR_MEM8(Base);
     }
 
     /** Usart Control and Status Register B
@@ -48,7 +57,7 @@ public:
      */
     static volatile uint8_t &getUCSRB()
     {
-        return _SFR_MEM8(0xC1 + ((uint8_t)UsartId * 0x08));
+        return _SFR_MEM8(Base + 0x01);
     }
 
     /** Usart Control and Status Register C
@@ -56,7 +65,7 @@ public:
      */
     static volatile uint8_t &getUCSRC()
     {
-        return _SFR_MEM8(0xC2 + ((uint8_t)UsartId * 0x08));
+        return _SFR_MEM8(Base + 0x02);
     }
 
     /** Usart Data Register
@@ -64,6 +73,6 @@ public:
      */
     static volatile uint8_t &getUDR()
     {
-        return _SFR_MEM8(0xC6 + ((uint8_t)UsartId * 0x08));
+        return _SFR_MEM8(Base + 0x06);
     }
 };
\ No newline at end of file
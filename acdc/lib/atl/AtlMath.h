@@ -38,6 +38,49 @@ public:
         return minOut + (OutT)(numerator / denominator);
     }
 
+    /** Returns the integer square root (rounded down).
+     *  Uses only shifts, adds and compares (no division or floating point).
+     *  \param value is the value to take the square root of.
+     *  \return Returns the largest number whose square is not larger than value.
+     */
+    static uint16_t Sqrt(uint32_t value)
+    {
+        uint32_t result = 0;
+        uint32_t bit = 1UL << 30;
+
+        while (bit > value)
+            bit >>= 2;
+
+        while (bit != 0)
+        {
+            if (value >= result + bit)
+            {
+                value -= result + bit;
+                result = (result >> 1) + bit;
+            }
+            else
+                result >>= 1;
+            bit >>= 2;
+        }
+
+        return (uint16_t)result;
+    }
+
+    /** Indicates if the value is a power of two (compile time).
+     */
+    static constexpr bool IsPowerOfTwo(uint32_t value)
+    {
+        return value != 0 && (value & (value - 1)) == 0;
+    }
+
+    /** Returns the base 2 logarithm (rounded down) of the value (compile time).
+     *  Use it to turn a multiply or divide by a power of two into a shift.
+     */
+    static constexpr uint8_t Log2(uint32_t value)
+    {
+        return value <= 1 ? 0 : 1 + Log2(value >> 1);
+    }
+
 private:
     Math() {}
 };
\ No newline at end of file
@@ -0,0 +1,172 @@
+#pragma once
+#include <stdint.h>
+
+/** The CobsDecoder decodes a stream of COBS (Consistent Overhead Byte Stuffing) frames byte by byte.
+ *  Each frame ends with a 0x00 delimiter; the encoded data never contains 0x00.
+ *  Any error (a delimiter in the middle of a block, a frame that is too long) drops the frame
+ *  and the decoder resynchronizes on the next delimiter.
+ *  \tparam MaxLength is the maximum length of a decoded frame.
+ */
+template <const uint8_t MaxLength>
+class CobsDecoder
+{
+public:
+    static const uint8_t Delimiter = 0x00;
+
+    enum class Result : uint8_t
+    {
+        Pending,  // more bytes are needed
+        Complete, // a frame is decoded: getData/getLength
+        Error,    // the frame is dropped
+    };
+
+    CobsDecoder()
+    {
+        Clear();
+    }
+
+    /** Decodes the next byte of the stream.
+     *  \param data is the received byte.
+     *  \return Returns Complete when a frame is decoded. The frame is valid until the next call.
+     */
+    Result Decode(uint8_t data)
+    {
+        if (data == Delimiter)
+        {
+            // a frame ends at a block boundary
+            bool complete = _state == State::Code && _started;
+            // idle delimiters and the end of a dropped frame are not errors
+            bool ignore = (_state == State::Code && !_started) || _state == State::Discard;
+            _completeLength = _length;
+            Clear();
+
+            if (complete)
+                return Result::Complete;
+            return ignore ? Result::Pending : Result::Error;
+        }
+
+        switch (_state)
+        {
+        case State::Code:
+            // the end of a block shorter than 254 bytes is a (stuffed) zero
+            if (_started && _code < 0xFF && !Append(0))
+                return Discard();
+
+            _started = true;
+            _code = data;
+            _remaining = data - 1;
+            if (_remaining > 0)
+                _state = State::Data;
+            return Result::Pending;
+
+        case State::Data:
+            if (!Append(data))
+                return Discard();
+
+            if (--_remaining == 0)
+                _state = State::Code;
+            return Result::Pending;
+
+        default:
+            return Result::Pending;
+        }
+    }
+
+    /** Starts a new frame.
+     */
+    void Clear()
+    {
+        _state = State::Code;
+        _started = false;
+        _code = 0;
+        _remaining = 0;
+        _length = 0;
+    }
+
+    const uint8_t *getData() const
+    {
+        return _buffer;
+    }
+
+    /** Returns the length of the frame that was completed last.
+     */
+    uint8_t getLength() const
+    {
+        return _completeLength;
+    }
+
+private:
+    enum class State : uint8_t
+    {
+        Code,
+        Data,
+        Discard,
+    };
+
+    State _state;
+    bool _started;
+    uint8_t _code;
+    uint8_t _remaining;
+    uint8_t _length;
+    uint8_t _completeLength = 0;
+    uint8_t _buffer[MaxLength];
+
+    bool Append(uint8_t data)
+    {
+        if (_length >= MaxLength)
+            return false;
+
+        _buffer[_length++] = data;
+        return true;
+    }
+
+    Result Discard()
+    {
+        _state = State::Discard;
+        return Result::Error;
+    }
+};
+
+/** The CobsEncoder writes a buffer as a COBS frame (including the 0x00 delimiter).
+ *  CobsEncoder is a static class and cannot be instantiated.
+ */
+class CobsEncoder
+{
+public:
+    /** Encodes and writes the data.
+     *  \tparam WriterT implements `void WriteData(uint8_t)`.
+     *  \param writer receives the encoded bytes.
+     *  \param data is the data to encode.
+     *  \param length is the number of bytes in data.
+     */
+    template <class WriterT>
+    static void Write(WriterT &writer, const uint8_t *data, uint8_t length)
+    {
+        uint8_t start = 0;
+        while (true)
+        {
+            // find the end of the block: the next zero, the end or 254 bytes
+            uint8_t end = start;
+            while (end < length && data[end] != 0 && end - start < 254)
+                end++;
+
+            uint8_t code = end - start + 1;
+            writer.WriteData(code);
+            for (uint8_t i = start; i < end; i++)
+            {
+                writer.WriteData(data[i]);
+            }
+
+            if (end >= length)
+                break;
+
+            // skip the zero (it is encoded by the code); a full block has no zero
+            start = code == 0xFF ? end : end + 1;
+        }
+
+        writer.WriteData(0x00);
+    }
+
+private:
+    CobsEncoder() {}
+};
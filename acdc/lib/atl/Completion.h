@@ -0,0 +1,97 @@
+#pragma once
+#include <stdint.h>
+
+/** The Completion signals the end of an asynchronous operation (I/O) to a Task.
+ *  The driver calls `Start()` when the operation is accepted and `Complete()` when it is done,
+ *  typically from its ISR. The Task waits with `Task_Await(completion)` (Task.h).
+ *  The Completion is owned by the caller and must stay alive until it is complete.
+ *
+ *  Example (inside a Task method):
+ *  \code
+ *  TwiAsync::Write(&_transaction, &_completion);
+ *  Task_Await(_completion);
+ *  if (_completion.getResult() != 0) ...
+ *  \endcode
+ */
+class Completion
+{
+public:
+    enum class State : uint8_t
+    {
+        Idle,     // not used
+        Pending,  // the operation is in progress
+        Complete, // the operation is done; result (and data) are set
+    };
+
+    /** The result code for a successful operation. */
+    static const uint8_t Ok = 0;
+
+    Completion()
+        : _state(State::Idle), _result(Ok), _data(nullptr)
+    {
+    }
+
+    /** Marks the operation as in progress.
+     *  Called by the driver that accepts the operation.
+     *  \return Returns false if an operation is already pending.
+     */
+    bool TryStart()
+    {
+        if (_state == State::Pending)
+            return false;
+
+        _result = Ok;
+        _data = nullptr;
+        _state = State::Pending;
+        return true;
+    }
+
+    /** Marks the operation as done. Can be called from an interrupt.
+     *  The state is written last so the result and data are valid when the Task sees it.
+     *  \param result is the (driver specific) result code. 0 (Ok) is success.
+     *  \param data is an optional pointer to the data of the operation.
+     */
+    void Complete(uint8_t result, void *data = nullptr)
+    {
+        _result = result;
+        _data = data;
+        _state = State::Complete;
+    }
+
+    /** Sets the Completion back to Idle.
+     */
+    void Reset()
+    {
+        _state = State::Idle;
+    }
+
+    bool getIsComplete() const
+    {
+        return _state == State::Complete;
+    }
+
+    bool getIsPending() const
+    {
+        return _state == State::Pending;
+    }
+
+    State getState() const
+    {
+        return _state;
+    }
+
+    uint8_t getResult() const
+    {
+        return _result;
+    }
+
+    void *getData() const
+    {
+        return _data;
+    }
+
+private:
+    volatile State _state;
+    volatile uint8_t _result;
+    void *volatile _data;
+};
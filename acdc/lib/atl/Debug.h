@@ -24,11 +24,44 @@ enum class DebugLevel : uint8_t
 
 const uint8_t DebugAnonymousComponentId = 0x00;
 
+/** Calculates the 32-bit FNV-1a hash of the text at compile time. Use DebugLog_Id(). */
+constexpr uint32_t DebugLogHash(const char *text, uint32_t hash = 2166136261UL)
+{
+    return *text == 0 ? hash : DebugLogHash(text + 1, (uint32_t)((hash ^ (uint8_t)*text) * 16777619UL));
+}
+
+// message id 0 is reserved (DebugLog reports lost records with it)
+constexpr uint16_t DebugLogFold(uint16_t id)
+{
+    return id == 0 ? 1 : id;
+}
+
+/** Folds the hash of the text to a 16-bit message id. Use DebugLog_Id(). */
+constexpr uint16_t DebugLogId(const char *text)
+{
+    return DebugLogFold((uint16_t)((DebugLogHash(text) >> 16) ^ DebugLogHash(text)));
+}
+
+template <const uint16_t Id>
+struct DebugLogIdOf
+{
+    static const uint16_t Value = Id;
+};
+
+/** Turns the message text into its (tokenized) message id at compile time.
+ *  The text itself is not stored in the program: the host decoder (tools/debuglog.py)
+ *  scans the sources for DebugLog_Id("...") and builds the string table.
+ */
+#define DebugLog_Id(text) (DebugLogIdOf<DebugLogId(text)>::Value)
+
 #ifdef DEBUG
 
 // Implement this method in your own code and route the message to the desired output.
 void AtlDebugWrite(const uint8_t componentId, const DebugLevel level, const char *message) __attribute__((weak));
 
+// Implement this method in your own code to queue a tokenized message (DebugLog_Id) with up to two arguments.
+void AtlDebugWriteId(const uint8_t componentId, const DebugLevel level, uint16_t messageId, int16_t arg0, int16_t arg1) __attribute__((weak));
+
 // Optionally implement this method in your own code and determine what debug level and components are debugged.
 bool AtlDebugFilter(const uint8_t componentId, DebugLevel debugLevel) __attribute__((weak));
 
@@ -54,6 +87,22 @@ public:
             AtlDebugWrite(ComponentId, DebugLevel, message);
     }
 
+    /** Logs the tokenized message to the debug target. Does not format or wait.
+     *  \tparam DebugLevel indicates for which level the message is intended.
+     *  Do not use `DebugLevel::Off`.
+     *  \param messageId is the id of the message text: `DebugLog_Id("text")`.
+     *  \param arg0 is an optional argument of the message.
+     *  \param arg1 is an optional argument of the message.
+     */
+    template <const DebugLevel DebugLevel>
+    static void Log(uint16_t messageId, int16_t arg0 = 0, int16_t arg1 = 0)
+    {
+        static_assert(DebugLevel != DebugLevel::Off, "Debug::Log: Do not use DebugLevel::Off.");
+
+        if (AtlDebugWriteId != nullptr && IsEnabled(DebugLevel))
+            AtlDebugWriteId(ComponentId, DebugLevel, messageId, arg0, arg1);
+    }
+
     /** Indicates if a message to the debug target for the specified ComponentId and debugLevel.
      *  \tparam DebugLevel indicates for which level the message is intended.
      *  Do not use `DebugLevel::Off`.
@@ -66,13 +115,18 @@ public:
 
         if (AtlDebugWrite == nullptr)
             return false;
-        if (AtlDebugFilter == nullptr)
-            return true;
-        return AtlDebugFilter(ComponentId, DebugLevel);
+        return IsEnabled(DebugLevel);
     }
 
 private:
     Debug() {}
+
+    static bool IsEnabled(DebugLevel debugLevel)
+    {
+        if (AtlDebugFilter == nullptr)
+            return true;
+        return AtlDebugFilter(ComponentId, debugLevel);
+    }
 };
 
 #else // DEBUG
@@ -92,6 +146,13 @@ public:
     template <const DebugLevel DebugLevel>
     static void Log(const char * /*message*/) {}
 
+    /** Does nothing.
+     *  \tparam DebugLevel is not used.
+     *  \param messageId is not used.
+     */
+    template <const DebugLevel DebugLevel>
+    static void Log(uint16_t /*messageId*/, int16_t /*arg0*/ = 0, int16_t /*arg1*/ = 0) {}
+
     /** Always returns false.
      *  \tparam DebugLevel is not used.
      *  \return Returns false.
@@ -114,6 +175,11 @@ void LogCritical(const char *message)
 {
     Debug<ComponentId>::template Log<DebugLevel::Critical>(message);
 }
+template <const uint8_t ComponentId>
+void LogCritical(uint16_t messageId, int16_t arg0 = 0, int16_t arg1 = 0)
+{
+    Debug<ComponentId>::template Log<DebugLevel::Critical>(messageId, arg0, arg1);
+}
 
 void LogError(const char *message)
 {
@@ -124,6 +190,11 @@ void LogError(const char *message)
 {
     Debug<ComponentId>::template Log<DebugLevel::Error>(message);
 }
+template <const uint8_t ComponentId>
+void LogError(uint16_t messageId, int16_t arg0 = 0, int16_t arg1 = 0)
+{
+    Debug<ComponentId>::template Log<DebugLevel::Error>(messageId, arg0, arg1);
+}
 
 void LogWarning(const char *message)
 {
@@ -134,6 +205,11 @@ void LogWarning(const char *message)
 {
     Debug<ComponentId>::template Log<DebugLevel::Warning>(message);
 }
+template <const uint8_t ComponentId>
+void LogWarning(uint16_t messageId, int16_t arg0 = 0, int16_t arg1 = 0)
+{
+    Debug<ComponentId>::template Log<DebugLevel::Warning>(messageId, arg0, arg1);
+}
 
 void LogInfo(const char *message)
 {
@@ -144,6 +220,11 @@ void LogInfo(const char *message)
 {
     Debug<ComponentId>::template Log<DebugLevel::Info>(message);
 }
+template <const uint8_t ComponentId>
+void LogInfo(uint16_t messageId, int16_t arg0 = 0, int16_t arg1 = 0)
+{
+    Debug<ComponentId>::template Log<DebugLevel::Info>(messageId, arg0, arg1);
+}
 
 void LogTrace(const char *message)
 {
@@ -154,6 +235,11 @@ void LogTrace(const char *message)
 {
     Debug<ComponentId>::template Log<DebugLevel::Trace>(message);
 }
+template <const uint8_t ComponentId>
+void LogTrace(uint16_t messageId, int16_t arg0 = 0, int16_t arg1 = 0)
+{
+    Debug<ComponentId>::template Log<DebugLevel::Trace>(messageId, arg0, arg1);
+}
 
 void LogDebug(const char *message)
 {
@@ -164,3 +250,8 @@ void LogDebug(const char *message)
 {
     Debug<ComponentId>::template Log<DebugLevel::Debug>(message);
 }
+template <const uint8_t ComponentId>
+void LogDebug(uint16_t messageId, int16_t arg0 = 0, int16_t arg1 = 0)
+{
+    Debug<ComponentId>::template Log<DebugLevel::Debug>(messageId, arg0, arg1);
+}
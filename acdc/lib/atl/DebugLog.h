@@ -0,0 +1,174 @@
+#pragma once
+#include <stdint.h>
+#include "Cobs.h"
+#include "Crc16.h"
+#include "Debug.h"
+#include "LockScope.h"
+#include "RingBuffer.h"
+
+/** The message id of the record that reports lost records (Arg0 is the number lost). */
+const uint16_t DebugLogOverflowId = 0;
+
+/** A tokenized log record as it is queued in RAM.
+ */
+struct DebugLogRecord
+{
+    uint16_t MessageId;
+    uint8_t ComponentId;
+    DebugLevel Level;
+    uint32_t Timestamp;
+    int16_t Arg0;
+    int16_t Arg1;
+};
+
+/** The DebugLog queues tokenized log records (`Debug<>::Log(DebugLog_Id("..."), arg0, arg1)`)
+ *  in a RAM ring and writes them later as binary frames, so logging never formats text or waits
+ *  on the Usart. Call `Write()` from AtlDebugWriteId and `TryWriteFrame()` from a low priority task.
+ *  When the ring is full the record is dropped and counted; a DebugLogOverflowId record is queued
+ *  in front of the next record, so the host sees the gap where it happened.
+ *
+ *  A frame is a leading 0x00 (resynchronizes after text output), followed by
+ *  COBS('L' MessageId ComponentId Level Timestamp Arg0 Arg1 CRC-hi CRC-lo) 0x00.
+ *  The fields are little endian, the CRC-16 (see Crc16) is MSB first like CommandFrame.
+ *  tools/debuglog.py decodes the frames and looks up the message text.
+ *  DebugLog is a static class and cannot be instantiated.
+ *  \tparam TimeT is the time source for the timestamp. Implements `uint32_t getTicks()`.
+ *  \tparam Size is the number of records the ring can hold (a power of two).
+ */
+template <class TimeT, const uint8_t Size = 8>
+class DebugLog
+{
+public:
+    /** Identifies a log record frame. */
+    static const uint8_t FrameType = 'L';
+    /** The maximum number of bytes written for one frame (delimiters included). */
+    static const uint8_t MaxFrameLength = 1 + 1 + (1 + 12 + 2) + 1;
+
+    /** Queues a record. Can be called from interrupts. Does not wait.
+     *  \param componentId is the source of the message.
+     *  \param level is the debug level of the message.
+     *  \param messageId is the `DebugLog_Id("text")` of the message.
+     *  \param arg0 is the first argument of the message.
+     *  \param arg1 is the second argument of the message.
+     *  \return Returns false if the ring is full (the record is dropped).
+     */
+    static bool Write(uint8_t componentId, DebugLevel level, uint16_t messageId, int16_t arg0, int16_t arg1)
+    {
+        DebugLogRecord record;
+        record.MessageId = messageId;
+        record.ComponentId = componentId;
+        record.Level = level;
+        record.Timestamp = TimeT::getTicks();
+        record.Arg0 = arg0;
+        record.Arg1 = arg1;
+
+        // main code and interrupts both log: one producer at a time
+        LockScope lock;
+        if (_dropped > 0)
+        {
+            // the overflow report goes first, the record needs a slot after it
+            if (_records.getCount() + 2 > Size)
+                return Drop();
+
+            _records.Write(OverflowRecord(record.Timestamp));
+            _dropped = 0;
+        }
+
+        if (_records.Write(record))
+            return true;
+        return Drop();
+    }
+
+    /** Writes the oldest record (or the overflow report) as a frame.
+     *  Make sure the writer has room for MaxFrameLength bytes, a partial frame is rejected by the host.
+     *  \tparam WriterT implements `void WriteData(uint8_t)`.
+     *  \param writer receives the frame bytes.
+     *  \return Returns false if there was nothing to write.
+     */
+    template <class WriterT>
+    static bool TryWriteFrame(WriterT &writer)
+    {
+        DebugLogRecord record;
+        if (!TryTakeDropped(&record) && !_records.TryRead(&record))
+            return false;
+
+        uint8_t frame[MaxFrameLength];
+        uint8_t length = 0;
+        frame[length++] = FrameType;
+        frame[length++] = record.MessageId & 0xFF;
+        frame[length++] = record.MessageId >> 8;
+        frame[length++] = record.ComponentId;
+        frame[length++] = static_cast<uint8_t>(record.Level);
+        for (uint8_t i = 0; i < 4; i++)
+        {
+            frame[length++] = (record.Timestamp >> (i * 8)) & 0xFF;
+        }
+        frame[length++] = (uint16_t)record.Arg0 & 0xFF;
+        frame[length++] = (uint16_t)record.Arg0 >> 8;
+        frame[length++] = (uint16_t)record.Arg1 & 0xFF;
+        frame[length++] = (uint16_t)record.Arg1 >> 8;
+
+        uint16_t crc = Crc16::Calculate(frame, length);
+        frame[length++] = crc >> 8;
+        frame[length++] = crc & 0xFF;
+
+        writer.WriteData(CobsDecoder<1>::Delimiter);
+        CobsEncoder::Write(writer, frame, length);
+        return true;
+    }
+
+    static bool getIsEmpty()
+    {
+        return _records.getIsEmpty() && _dropped == 0;
+    }
+
+    /** Returns the number of records dropped that are not reported yet.
+     */
+    static uint16_t getDroppedCount()
+    {
+        LockScope lock;
+        return _dropped;
+    }
+
+private:
+    static RingBufferSpsc<DebugLogRecord, Size> _records;
+    static uint16_t _dropped;
+
+    DebugLog() {}
+
+    static bool Drop()
+    {
+        if (_dropped < 0xFFFF)
+            _dropped++;
+        return false;
+    }
+
+    static DebugLogRecord OverflowRecord(uint32_t timestamp)
+    {
+        DebugLogRecord record;
+        record.MessageId = DebugLogOverflowId;
+        record.ComponentId = DebugAnonymousComponentId;
+        record.Level = DebugLevel::Warning;
+        record.Timestamp = timestamp;
+        record.Arg0 = (int16_t)_dropped;
+        record.Arg1 = 0;
+        return record;
+    }
+
+    // a loss at the end of the log is reported once the ring has drained
+    static bool TryTakeDropped(DebugLogRecord *outRecord)
+    {
+        LockScope lock;
+        if (_dropped == 0 || !_records.getIsEmpty())
+            return false;
+
+        *outRecord = OverflowRecord(TimeT::getTicks());
+        _dropped = 0;
+        return true;
+    }
+};
+
+template <class TimeT, const uint8_t Size>
+RingBufferSpsc<DebugLogRecord, Size> DebugLog<TimeT, Size>::_records;
+template <class TimeT, const uint8_t Size>
+uint16_t DebugLog<TimeT, Size>::_dropped = 0;
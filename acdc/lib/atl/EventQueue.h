@@ -0,0 +1,155 @@
+#pragma once
+#include <stdint.h>
+
+/** The EventQueue is a fixed-size queue of events that is read by multiple subscribers.
+ *  Each event is published once and read once by every subscriber.
+ *  Each subscriber has its own read position, so a subscriber only sees the events
+ *  that were published since it last read the queue.
+ *  An event is released when all subscribers have read it.
+ *  Publishing never fails: when a subscriber lags a full queue behind it loses its oldest event
+ *  and is marked overrun (see `TryTakeOverrun()`), so it can resynchronize from the current state.
+ *  The other subscribers are not affected.
+ *  The queue is not interrupt safe: publish and read from the main loop.
+ *  Capacity is always one less than the specified Size.
+ *  \tparam EventT is the data type of the events.
+ *  \tparam Size is the number of events in the queue (max 254).
+ *  \tparam SubscriberCount is the number of subscribers. Subscribers are identified by their index.
+ */
+template <typename EventT, const uint8_t Size, const uint8_t SubscriberCount>
+class EventQueue
+{
+    static_assert(Size > 1, "Size must be bigger than 1.");
+    static_assert(Size < 255, "Size must be less than 255!");
+    static_assert(SubscriberCount > 0, "SubscriberCount must be at least 1.");
+
+public:
+    typedef EventT ItemT;
+
+    /** Constructs the instance.
+     */
+    EventQueue()
+    {
+        Clear();
+    }
+
+    /** Clears the queue for all subscribers.
+     *  The dropped event count and the overrun flags are also reset.
+     */
+    void Clear()
+    {
+        _writeIndex = 0;
+        _droppedCount = 0;
+        for (uint8_t i = 0; i < SubscriberCount; i++)
+        {
+            _readIndex[i] = 0;
+            _overrun[i] = false;
+        }
+    }
+
+    /** Publishes a new event to all subscribers.
+     *  A subscriber that has a full queue loses its oldest event and is marked overrun.
+     *  \param event is the event to publish.
+     *  \return Returns false if a subscriber has lost an event (counted as dropped).
+     */
+    bool Publish(const EventT &event)
+    {
+        uint8_t newIndex = Next(_writeIndex);
+        bool dropped = false;
+
+        for (uint8_t i = 0; i < SubscriberCount; i++)
+        {
+            if (_readIndex[i] == newIndex)
+            {
+                // only the lagging subscriber skips its oldest event
+                _readIndex[i] = Next(newIndex);
+                _overrun[i] = true;
+                dropped = true;
+            }
+        }
+
+        _buffer[_writeIndex] = event;
+        _writeIndex = newIndex;
+
+        if (dropped && _droppedCount < 0xFF)
+            _droppedCount++;
+        return !dropped;
+    }
+
+    /** Reads the next event for the subscriber.
+     *  \param subscriber is the index of the subscriber.
+     *  \param outEvent receives the event.
+     *  \return Returns false if there are no new events for the subscriber.
+     */
+    bool TryRead(uint8_t subscriber, EventT *outEvent)
+    {
+        uint8_t index = _readIndex[subscriber];
+        if (index == _writeIndex)
+            return false;
+
+        *outEvent = _buffer[index];
+        _readIndex[subscriber] = Next(index);
+        return true;
+    }
+
+    /** Retrieves (once) that the subscriber has lost events since the last call.
+     *  The subscriber should rebuild its state from the source instead of the events.
+     *  \param subscriber is the index of the subscriber.
+     *  \return Returns true if events were lost.
+     */
+    bool TryTakeOverrun(uint8_t subscriber)
+    {
+        if (!_overrun[subscriber])
+            return false;
+
+        _overrun[subscriber] = false;
+        return true;
+    }
+
+    /** Indicates if the subscriber has any events to read.
+     *  \param subscriber is the index of the subscriber.
+     *  \return Returns true if there are no new events for the subscriber.
+     */
+    bool getIsEmpty(uint8_t subscriber) const
+    {
+        return _readIndex[subscriber] == _writeIndex;
+    }
+
+    /** Retrieves the number of events the subscriber has not read yet.
+     *  \param subscriber is the index of the subscriber.
+     *  \return Returns the number of events.
+     */
+    uint8_t getCount(uint8_t subscriber) const
+    {
+        uint8_t readIndex = _readIndex[subscriber];
+        if (_writeIndex >= readIndex)
+            return _writeIndex - readIndex;
+
+        return Size - (readIndex - _writeIndex);
+    }
+
+    /** Retrieves the number of events that were lost by at least one (lagging) subscriber.
+     *  \return Returns the count (saturates at 255).
+     */
+    uint8_t getDroppedCount() const
+    {
+        return _droppedCount;
+    }
+
+    uint8_t getCapacity() const
+    {
+        return Size - 1;
+    }
+
+private:
+    EventT _buffer[Size];
+    uint8_t _writeIndex;
+    uint8_t _readIndex[SubscriberCount];
+    bool _overrun[SubscriberCount];
+    uint8_t _droppedCount;
+
+    inline static uint8_t Next(uint8_t index)
+    {
+        index++;
+        return index >= Size ? 0 : index;
+    }
+};
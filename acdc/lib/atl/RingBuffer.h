@@ -1,5 +1,6 @@
 #pragma once
 #include <stdint.h>
+#include "AtlMath.h"
 #include "LockScope.h"
 
 /** A RingBuffer uses a fixed amount of memory to simulate an 'endless' buffer.
@@ -245,10 +246,10 @@ public:
      */
     uint16_t Read(T *outData, uint16_t maxCount)
     {
-        T *p = outData;
         uint16_t count = 0;
 
-        while (TryRead(p++) && count < maxCount)
+        // check the count first: a TryRead would consume an item that does not fit
+        while (count < maxCount && TryRead(outData + count))
         {
             count++;
         }
@@ -283,4 +284,197 @@ private:
     volatile T _buffer[ActualSize];
     volatile uint8_t _writeIndex;
     volatile uint8_t _readIndex;
-};
\ No newline at end of file
+};
+
+//-----------------------------------------------------------------------------
+
+/** A lock-free single-producer/single-consumer RingBuffer for passing data
+ *  between an interrupt handler and the main loop.
+ *  One side only writes (Write/WriteSpan), the other side only reads (Read/TryRead/ReadSpan/Clear).
+ *  The indexes are free running bytes that are masked on access: each side updates only its own index
+ *  with a single (atomic) byte store after the data is copied, so interrupts are never disabled.
+ *  All Size items can be used (no empty slot).
+ *  \tparam T is the data type of the buffer items.
+ *  \tparam Size is the number of 'T' items in the buffer (a power of two, max 128).
+ */
+template <typename T, const uint8_t Size>
+class RingBufferSpsc
+{
+    static_assert(Math::IsPowerOfTwo(Size), "Size must be a power of two.");
+    static_assert(Size <= 128, "Size must be 128 or less.");
+    static const uint8_t Mask = Size - 1;
+
+public:
+    typedef T ItemT;
+
+    /** Constructs the instance.
+     */
+    RingBufferSpsc()
+        : _writeIndex(0), _readIndex(0)
+    {
+    }
+
+    /** Clears the buffer (consumer side).
+     *  The actual content is not deleted or reset.
+     */
+    void Clear()
+    {
+        _readIndex = _writeIndex;
+    }
+
+    /** Writes the value to the buffer (producer side).
+     *  The method protects against overrun.
+     *  \param value is the value to store in the buffer.
+     *  \return Returns true when successful.
+     */
+    bool Write(T value)
+    {
+        uint8_t index = _writeIndex;
+        if ((uint8_t)(index - _readIndex) >= Size)
+            return false;
+
+        Barrier();
+        _buffer[index & Mask] = value;
+        Barrier();
+        _writeIndex = index + 1;
+        return true;
+    }
+
+    /** Writes as many values as fit in the buffer (producer side).
+     *  The values are made available to the consumer all at once.
+     *  \param data points to the values to write.
+     *  \param count is the number of values to write.
+     *  \return Returns the number of values written.
+     */
+    uint8_t WriteSpan(const T *data, uint8_t count)
+    {
+        uint8_t index = _writeIndex;
+        uint8_t free = Size - (uint8_t)(index - _readIndex);
+        if (count > free)
+            count = free;
+        Barrier();
+
+        // at most two contiguous regions: up to the end of the buffer and from the start
+        uint8_t start = index & Mask;
+        uint8_t first = Size - start;
+        if (first > count)
+            first = count;
+
+        for (uint8_t i = 0; i < first; i++)
+        {
+            _buffer[start + i] = data[i];
+        }
+        for (uint8_t i = first; i < count; i++)
+        {
+            _buffer[i - first] = data[i];
+        }
+
+        Barrier();
+        _writeIndex = index + count;
+        return count;
+    }
+
+    /** Reads one value from the buffer (consumer side).
+     *  The method does NOT protect against under-run. Call `getCount()` or `getIsEmpty()`.
+     *  \return Returns the value.
+     */
+    T Read()
+    {
+        uint8_t index = _readIndex;
+        Barrier();
+        T result = _buffer[index & Mask];
+        Barrier();
+        _readIndex = index + 1;
+        return result;
+    }
+
+    /** Reads one value from the buffer (consumer side).
+     *  The method does protect against under-run.
+     *  \param outData is the value to store the read value.
+     *  \return Returns true if the read was successfull and outData was filled.
+     */
+    bool TryRead(T *outData)
+    {
+        if (getIsEmpty())
+            return false;
+
+        *outData = Read();
+        return true;
+    }
+
+    /** Returns the value that `Read()` would return, without removing it (consumer side).
+     *  The method does NOT protect against under-run.
+     */
+    const T &Peek() const
+    {
+        Barrier();
+        return _buffer[_readIndex & Mask];
+    }
+
+    /** Reads as many values as are available (consumer side).
+     *  \param outData receives the values.
+     *  \param maxCount is the maximum number of values to read.
+     *  \return Returns the number of values read.
+     */
+    uint8_t ReadSpan(T *outData, uint8_t maxCount)
+    {
+        uint8_t index = _readIndex;
+        uint8_t count = _writeIndex - index;
+        if (count > maxCount)
+            count = maxCount;
+        Barrier();
+
+        uint8_t start = index & Mask;
+        uint8_t first = Size - start;
+        if (first > count)
+            first = count;
+
+        for (uint8_t i = 0; i < first; i++)
+        {
+            outData[i] = _buffer[start + i];
+        }
+        for (uint8_t i = first; i < count; i++)
+        {
+            outData[i] = _buffer[i - first];
+        }
+
+        Barrier();
+        _readIndex = index + count;
+        return count;
+    }
+
+    /** Retrieves the number of values in the buffer.
+     *  Exact for the consumer; the producer may see a value that is (briefly) too high.
+     *  \return Returns the length of the buffer.
+     */
+    uint8_t getCount() const
+    {
+        return _writeIndex - _readIndex;
+    }
+
+    bool getIsEmpty() const
+    {
+        return _writeIndex == _readIndex;
+    }
+
+    bool getCanWrite() const
+    {
+        return getCount() < Size;
+    }
+
+    uint8_t getCapacity() const
+    {
+        return Size;
+    }
+
+private:
+    T _buffer[Size];
+    volatile uint8_t _writeIndex;
+    volatile uint8_t _readIndex;
+
+    // keeps the buffer access between reading the other index and publishing our own
+    static void Barrier()
+    {
+        __asm__ __volatile__("" ::: "memory");
+    }
+};
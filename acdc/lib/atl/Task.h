@@ -93,3 +93,10 @@
 #define Task_Yield() \
     Task_YieldUntil(true)
 
+/** MACRO: Asynchronously waits for the Completion (Completion.h) of an I/O operation.
+ *  The completion is typically set from the ISR of the driver that performs the operation.
+ *  Check `getResult()` of the completion after the await.
+ *  \return Returns false from the Task procedure.
+ */
+#define Task_Await(completion) \
+    Task_WaitUntil((completion).getIsComplete())
@@ -0,0 +1,263 @@
+#pragma once
+#include <stdint.h>
+#include "LockScope.h"
+
+/** The NoTaskMonitor is the default (empty) monitor of the TaskScheduler.
+ *  See TaskProfiler.h (execution times) and TaskWatchdog.h (deadline supervision).
+ */
+class NoTaskMonitor
+{
+public:
+    static void BeginTask(uint8_t taskId) { (void)taskId; }
+    static void EndTask(uint8_t taskId) { (void)taskId; }
+    static void MarkLoop() {}
+
+private:
+    NoTaskMonitor() {}
+};
+
+/** The TaskMonitors combines two monitors into one, so both are called by the TaskScheduler.
+ *  \tparam FirstT is the first monitor. It is called first.
+ *  \tparam SecondT is the second monitor. Use a TaskMonitors for more than two.
+ */
+template <class FirstT, class SecondT>
+class TaskMonitors
+{
+public:
+    static void BeginTask(uint8_t taskId)
+    {
+        FirstT::BeginTask(taskId);
+        SecondT::BeginTask(taskId);
+    }
+    static void EndTask(uint8_t taskId)
+    {
+        FirstT::EndTask(taskId);
+        SecondT::EndTask(taskId);
+    }
+    static void MarkLoop()
+    {
+        FirstT::MarkLoop();
+        SecondT::MarkLoop();
+    }
+
+private:
+    TaskMonitors() {}
+};
+
+/** The TaskScheduler runs registered tasks when they are ready, in priority order.
+ *  A task is a (trampoline) function that typically calls the Run method of a Task (Task.h).
+ *  Each task registers with a priority and a wake condition:
+ *  - Always: the task runs on every pass (polling).
+ *  - Timer: the task runs periodically, or once after `WakeAfter()`.
+ *  - Event: the task runs after `Signal()` is called, typically from an ISR on I/O completion.
+ *  A task that has not woken up costs nothing but a bit test.
+ *  Between two tasks a newly signaled task with a higher priority goes first (cooperative: tasks are never interrupted).
+ *  TaskScheduler is a static class and cannot be instantiated.
+ *  \tparam TimeT is the Time class used for the timers. TimeT implements `uint32_t getTicks()`.
+ *  \tparam MaxTasks is the maximum number of tasks that can be registered (max 16).
+ *  \tparam MonitorT is called around each task and on each pass. It implements
+ *  `static void BeginTask(uint8_t)`, `static void EndTask(uint8_t)` and `static void MarkLoop()`.
+ */
+template <class TimeT, const uint8_t MaxTasks, class MonitorT = NoTaskMonitor>
+class TaskScheduler
+{
+    static_assert(MaxTasks > 0, "MaxTasks must be at least 1.");
+    static_assert(MaxTasks <= 16, "MaxTasks must be 16 or less.");
+
+public:
+    typedef void (*TaskFunction)();
+
+    /** Determines when a task is ready to run.
+     */
+    enum class WakeCondition : uint8_t
+    {
+        Always,
+        Timer,
+        Event,
+    };
+
+    static const uint8_t InvalidTaskId = 0xFF;
+
+    /** Registers a task.
+     *  \param function is called when the task is ready.
+     *  \param priority of the task: 0 is the highest priority.
+     *  \param wake is the condition that makes the task ready.
+     *  \param period is the time (ticks) between runs for a Timer task. 0 for a one-shot timer (`WakeAfter()`).
+     *  \return Returns the id of the task or InvalidTaskId when full.
+     */
+    static uint8_t Register(TaskFunction function, uint8_t priority, WakeCondition wake, uint32_t period = 0)
+    {
+        if (_count >= MaxTasks)
+            return InvalidTaskId;
+
+        uint8_t taskId = _count++;
+        _functions[taskId] = function;
+        _priorities[taskId] = priority;
+        _periods[taskId] = period;
+
+        // keep _order sorted on priority (stable)
+        uint8_t i = taskId;
+        while (i > 0 && _priorities[_order[i - 1]] > priority)
+        {
+            _order[i] = _order[i - 1];
+            i--;
+        }
+        _order[i] = taskId;
+
+        uint16_t mask = 1U << taskId;
+        if (wake == WakeCondition::Always)
+            _always |= mask;
+        else if (wake == WakeCondition::Timer && period > 0)
+            WakeAfter(taskId, period);
+
+        return taskId;
+    }
+
+    /** Makes the task ready to run.
+     *  Can be called from an interrupt.
+     *  \param taskId is the id of the task. An InvalidTaskId is ignored.
+     */
+    static void Signal(uint8_t taskId)
+    {
+        if (taskId >= MaxTasks)
+            return;
+
+        LockScope lock;
+        _ready |= 1U << taskId;
+    }
+
+    /** Makes the task ready to run after the specified time.
+     *  \param taskId is the id of the task.
+     *  \param time is the time in ticks of TimeT.
+     */
+    static void WakeAfter(uint8_t taskId, uint32_t time)
+    {
+        _wakeAt[taskId] = TimeT::getTicks() + time;
+        _timers |= 1U << taskId;
+    }
+
+    /** Runs all ready tasks once, in priority order.
+     *  \return Returns the number of tasks that have run. 0 (zero) means idle.
+     */
+    static uint8_t RunReady()
+    {
+        MonitorT::MarkLoop();
+        UpdateTimers();
+
+        uint16_t pending = _always;
+        uint8_t count = 0;
+
+        while (true)
+        {
+            pending |= TakeReady();
+
+            uint8_t taskId = Next(pending);
+            if (taskId == InvalidTaskId)
+                break;
+
+            pending &= ~(1U << taskId);
+            MonitorT::BeginTask(taskId);
+            _functions[taskId]();
+            MonitorT::EndTask(taskId);
+            count++;
+        }
+
+        return count;
+    }
+
+    /** Indicates if any task is ready to run.
+     *  Always tasks are always ready. Timers are checked by `RunReady()`.
+     *  Use it to decide if the MCU can sleep until the next interrupt.
+     */
+    static bool getHasReady()
+    {
+        return _ready != 0 || _always != 0;
+    }
+
+    static uint8_t getCount()
+    {
+        return _count;
+    }
+
+private:
+    static TaskFunction _functions[MaxTasks];
+    static uint8_t _priorities[MaxTasks];
+    static uint8_t _order[MaxTasks];
+    static uint32_t _periods[MaxTasks];
+    static uint32_t _wakeAt[MaxTasks];
+    static uint8_t _count;
+    static uint16_t _always;
+    static uint16_t _timers;
+    static volatile uint16_t _ready;
+
+    static uint16_t TakeReady()
+    {
+        LockScope lock;
+        uint16_t ready = _ready;
+        _ready = 0;
+        return ready;
+    }
+
+    static uint8_t Next(uint16_t pending)
+    {
+        if (pending == 0)
+            return InvalidTaskId;
+
+        for (uint8_t i = 0; i < _count; i++)
+        {
+            uint8_t taskId = _order[i];
+            if (pending & (1U << taskId))
+                return taskId;
+        }
+        return InvalidTaskId;
+    }
+
+    static void UpdateTimers()
+    {
+        if (_timers == 0)
+            return;
+
+        uint32_t now = TimeT::getTicks();
+        for (uint8_t taskId = 0; taskId < _count; taskId++)
+        {
+            uint16_t mask = 1U << taskId;
+            if ((_timers & mask) == 0 ||
+                (int32_t)(now - _wakeAt[taskId]) < 0)
+                continue;
+
+            if (_periods[taskId] > 0)
+            {
+                // no drift: next wake is relative to the previous
+                _wakeAt[taskId] += _periods[taskId];
+                // unless we are too late
+                if ((int32_t)(now - _wakeAt[taskId]) >= 0)
+                    _wakeAt[taskId] = now + _periods[taskId];
+            }
+            else
+                _timers &= ~mask;
+
+            Signal(taskId);
+        }
+    }
+
+    TaskScheduler() {}
+};
+
+template <class TimeT, const uint8_t MaxTasks, class MonitorT>
+typename TaskScheduler<TimeT, MaxTasks, MonitorT>::TaskFunction TaskScheduler<TimeT, MaxTasks, MonitorT>::_functions[] = {};
+template <class TimeT, const uint8_t MaxTasks, class MonitorT>
+uint8_t TaskScheduler<TimeT, MaxTasks, MonitorT>::_priorities[] = {};
+template <class TimeT, const uint8_t MaxTasks, class MonitorT>
+uint8_t TaskScheduler<TimeT, MaxTasks, MonitorT>::_order[] = {};
+template <class TimeT, const uint8_t MaxTasks, class MonitorT>
+uint32_t TaskScheduler<TimeT, MaxTasks, MonitorT>::_periods[] = {};
+template <class TimeT, const uint8_t MaxTasks, class MonitorT>
+uint32_t TaskScheduler<TimeT, MaxTasks, MonitorT>::_wakeAt[] = {};
+template <class TimeT, const uint8_t MaxTasks, class MonitorT>
+uint8_t TaskScheduler<TimeT, MaxTasks, MonitorT>::_count = 0;
+template <class TimeT, const uint8_t MaxTasks, class MonitorT>
+uint16_t TaskScheduler<TimeT, MaxTasks, MonitorT>::_always = 0;
+template <class TimeT, const uint8_t MaxTasks, class MonitorT>
+uint16_t TaskScheduler<TimeT, MaxTasks, MonitorT>::_timers = 0;
+template <class TimeT, const uint8_t MaxTasks, class MonitorT>
+volatile uint16_t TaskScheduler<TimeT, MaxTasks, MonitorT>::_ready = 0;
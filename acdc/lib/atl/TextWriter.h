@@ -1,7 +1,15 @@
 #pragma once
 #include <stdint.h>
+#include <avr/pgmspace.h>
 #include "TextFormatInfo.h"
 
+#ifndef F
+/** Marks a string (literal) that lives in flash (see `F()`). Compatible with Arduino. */
+class __FlashStringHelper;
+/** Places the string literal in flash (PROGMEM) instead of RAM: `writer.Write(F("text"));` */
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(PSTR(string_literal)))
+#endif
+
 /** The TextWriter class writes textual representations to a
  *  \tparam BaseT is derived from and implements 'void Write(byte)'.
  *  \tparam FormatInfoT implements all the public static fields defined by TextFormatInfo
@@ -42,6 +50,27 @@ public:
         }
     }
 
+    /** Writes a string that is stored in flash (`F("text")`) to the out stream as is.
+     *  \param str points to the string in flash.
+     */
+    void Write(const __FlashStringHelper *str)
+    {
+        WriteP(reinterpret_cast<PGM_P>(str));
+    }
+
+    /** Writes a string that is stored in flash (PROGMEM, PSTR) to the out stream as is.
+     *  Does NOT write the terminating zero!
+     *  \param str points to the string in flash.
+     */
+    void WriteP(PGM_P str)
+    {
+        char c;
+        while ((c = pgm_read_byte(str++)) != '\0')
+        {
+            BaseT::Write(c);
+        }
+    }
+
     /** Writes a textual representation for the value.
      *  \param value is the number to convert to string.
      *  \param fixedLength is the number of total characters to display (leading zeros).
@@ -54,7 +83,8 @@ public:
             if (value < 0)
             {
                 BaseT::Write(FormatInfoT::NegativeSign);
-                WriteInt(-value, FormatInfoT::DefaultBase, fixedLength);
+                // (unsigned) also correct for -32768
+                WriteInt(0 - (uint16_t)value, FormatInfoT::DefaultBase, fixedLength);
             }
             else
             {
@@ -87,7 +117,7 @@ public:
             if (value < 0)
             {
                 BaseT::Write(FormatInfoT::NegativeSign);
-                WriteLong(-value, FormatInfoT::DefaultBase, fixedLength);
+                WriteLong(0 - (uint32_t)value, FormatInfoT::DefaultBase, fixedLength);
             }
             else
             {
@@ -160,6 +190,24 @@ public:
         WriteLine();
     }
 
+    /** Writes a string that is stored in flash (`F("text")`) followed by a NewLine.
+     *  \param str points to the string in flash.
+     */
+    void WriteLine(const __FlashStringHelper *str)
+    {
+        Write(str);
+        WriteLine();
+    }
+
+    /** Writes a string that is stored in flash (PROGMEM, PSTR) followed by a NewLine.
+     *  \param str points to the string in flash.
+     */
+    void WriteLineP(PGM_P str)
+    {
+        WriteP(str);
+        WriteLine();
+    }
+
     /** Writes a textual representation for the value followed by a NewLine.
      *  \param value is the number to convert to string.
      */
@@ -207,17 +255,94 @@ public:
 
     void WriteInt(uint16_t integer, uint8_t base, const uint8_t fixedLength = 0)
     {
+        if (base == TextFormatInfo::baseDecimal)
+        {
+            WriteDecimal(integer, fixedLength);
+            return;
+        }
+
         // an int is 2^32 and has 10 digits + terminating 0
         WriteInternal<unsigned int, 11>(integer, base, fixedLength);
     }
 
     void WriteLong(uint32_t integer, uint8_t base, const uint8_t fixedLength = 0)
     {
+        if (base == TextFormatInfo::baseDecimal)
+        {
+            WriteDecimal(integer, fixedLength);
+            return;
+        }
+
         // a long is 2^64 and has 20 digits + terminating 0
         WriteInternal<uint32_t, 21>(integer, base, fixedLength);
     }
 
 private:
+    // decimal digits without a division (the AVR has no divide instruction: ~200 cycles per digit).
+    // value / 10 == (value * 0xCCCD) >> 19 for all 16-bit values.
+    void WriteDecimal(uint16_t value, const uint8_t fixedLength)
+    {
+        char digits[5];
+        uint8_t length = 0;
+
+        do
+        {
+            uint16_t quotient = ((uint32_t)value * 0xCCCD) >> 19;
+            digits[length++] = '0' + (uint8_t)(value - quotient * 10);
+            value = quotient;
+        } while (value != 0);
+
+        // leading zeros
+        for (uint8_t i = length; i < fixedLength; i++)
+        {
+            BaseT::Write('0');
+        }
+
+        while (length > 0)
+        {
+            BaseT::Write(digits[--length]);
+        }
+    }
+
+    // 32-bit decimal digits by subtracting powers of ten (max 9 subtractions per digit).
+    void WriteDecimal(uint32_t value, const uint8_t fixedLength)
+    {
+        if (value <= 0xFFFF)
+        {
+            WriteDecimal((uint16_t)value, fixedLength);
+            return;
+        }
+
+        static const uint32_t PowersOfTen[] PROGMEM = {
+            1000000000, 100000000, 10000000, 1000000, 100000, 10000, 1000, 100, 10};
+
+        // more than 16 bits: at least 5 digits (max 10)
+        for (uint8_t i = 10; i < fixedLength; i++)
+        {
+            BaseT::Write('0');
+        }
+
+        bool started = false;
+        for (uint8_t i = 0; i < 9; i++)
+        {
+            uint32_t power = pgm_read_dword(&PowersOfTen[i]);
+            char digit = '0';
+            while (value >= power)
+            {
+                value -= power;
+                digit++;
+            }
+
+            // the number of digits from here on is 10 - i
+            if (started || digit != '0' || fixedLength >= 10 - i)
+            {
+                BaseT::Write(digit);
+                started = true;
+            }
+        }
+        BaseT::Write((char)('0' + value));
+    }
+
     template <typename T, const uint8_t bufferSize>
     void WriteInternal(T integer, uint8_t base, const uint8_t fixedLength)
     {
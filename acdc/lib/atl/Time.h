@@ -47,12 +47,21 @@ public:
     }
 
     /** Returns the raw time ticks.
+     *  The ticks wrap (after 49 days in ms, 71 minutes in us); compare them by subtraction.
      */
     static uint32_t getTicks()
     {
         return _ticks;
     }
 
+    /** Returns the raw time ticks in 64-bit: the ticks with the number of wraps on top.
+     *  A wrap is detected by `Update()`, which must be called at least once per wrap period.
+     */
+    static uint64_t getTicks64()
+    {
+        return ((uint64_t)_epoch << 32) | _ticks;
+    }
+
     static uint32_t ForMilliseconds(uint32_t milliseconds)
     {
         return ::getMilliseconds<ResolutionId>(milliseconds);
@@ -76,10 +85,13 @@ public:
 private:
     Time() {}
     static uint32_t _ticks;
+    static uint16_t _epoch;
 };
 
 template <const TimeResolution ResolutionId>
 uint32_t Time<ResolutionId>::_ticks = 0;
+template <const TimeResolution ResolutionId>
+uint16_t Time<ResolutionId>::_epoch = 0;
 
 /** Captures the time ticks (specialized).
  *  \return Returns delta-time in microseconds.
@@ -89,6 +101,8 @@ uint32_t Time<TimeResolution::Microseconds>::Update()
 {
     uint32_t previous = _ticks;
     _ticks = TimerCounterT::getMicroseconds();
+    if (_ticks < previous)
+        _epoch++;
     return _ticks - previous;
 }
 
@@ -100,6 +114,8 @@ uint32_t Time<TimeResolution::Milliseconds>::Update()
 {
     uint32_t previous = _ticks;
     _ticks = TimerCounterT::getMilliseconds();
+    if (_ticks < previous)
+        _epoch++;
     return _ticks - previous;
 }
 
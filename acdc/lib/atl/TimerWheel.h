@@ -0,0 +1,483 @@
+#pragma once
+#include <stdint.h>
+#include "Debug.h"
+
+/** The TimerWheel is a Delays compatible scheduler that keeps its delays in a hierarchical timer wheel.
+ *  Arming, aborting and expiring a delay are O(1): the cost of `Update()` depends on the elapsed time,
+ *  not on the number of running delays.
+ *  The wheel has 4 levels of 16 slots each (1, 16, 256 and 4096 ticks per slot).
+ *  Delays longer than 65535 ticks are re-armed when they reach the top level.
+ *
+ *  There are two ways to use it:
+ *  - handle based: `Wait(handle, time)` with a `uint8_t` handle the caller keeps (initialized to InvalidHandle).
+ *    This is the fastest way, no lookup is needed.
+ *  - id based (Delays compatible): `Delay(id, time)`. The id is looked up in a small hash table.
+ *
+ *  When all slots are in use the delay is not started. A warning is logged once, when the wheel becomes full.
+ *  `Delay()` and `Wait()` then return false (keep waiting) and try again on the next call
+ *  (Delays reports the delay as done).
+ *
+ *  TimerWheel is a static class and cannot be instantiated.
+ *  \tparam TimeT is the Time class to use - indicating time in Milliseconds or Microseconds.
+ *  TimeT implements: `uint32_t Update()` - returns the delta-Time and `uint32_t getTicks()`.
+ *  \tparam MaxItems is the maximum number of delays that can be running (max 254).
+ *  \tparam TimeUnitT is the data type of the delay time.
+ *
+ *  For each item 10 bytes are pre-allocated, plus 64 bytes for the wheel and MaxItems (rounded up to a power of two) for the id lookup.
+ */
+template <class TimeT, const uint8_t MaxItems, typename TimeUnitT = uint32_t>
+class TimerWheel : public TimeT
+{
+    static_assert(MaxItems > 0, "MaxItems must be at least 1.");
+    static_assert(MaxItems < 255, "MaxItems must be less than 255!");
+
+    static const uint8_t Levels = 4;
+    static const uint8_t SlotBits = 4;
+    static const uint8_t SlotCount = 1 << SlotBits;
+    static const uint8_t SlotMask = SlotCount - 1;
+    static const uint32_t MaxSpan = (1UL << (Levels * SlotBits)) - 1;
+    static const uint8_t HashSize = MaxItems <= 4 ? 4 : MaxItems <= 8 ? 8 : MaxItems <= 16 ? 16 : MaxItems <= 32 ? 32 : MaxItems <= 64 ? 64 : 128;
+    static const uint8_t NoItem = 0xFF;
+
+    enum class ItemState : uint8_t
+    {
+        Free,
+        Armed,
+        Expired
+    };
+
+public:
+    static const uint8_t DebugComponentId = 30;
+
+    /** The invalid handle value. Initialize handles to this value.
+     */
+    static const uint8_t InvalidHandle = NoItem;
+
+    /** The invalid id value.
+     */
+    static uint16_t InvalidId;
+
+    /** Calls Time::Update and advances the wheel.
+     *  Expired delays are marked and reported by the next call to `Delay()` or `Wait()`.
+     *  \return Returns the delta time in units indicated by how Time was constructed.
+     */
+    static uint32_t Update()
+    {
+        _delta = TimeT::Update();
+        uint32_t now = TimeT::getTicks();
+
+        if (_armedCount == 0)
+        {
+            _now = now;
+            return _delta;
+        }
+
+        while (_now != now)
+        {
+            _now++;
+            Tick();
+        }
+
+        return _delta;
+    }
+
+    // handle based
+
+    /** Starts a new delay.
+     *  \param time is the delay time in units the TimeT was constructed with.
+     *  \return Returns the handle of the delay or InvalidHandle when full.
+     */
+    static uint8_t Schedule(TimeUnitT time)
+    {
+        uint8_t item = Allocate();
+        if (item == NoItem)
+            return InvalidHandle;
+
+        Arm(item, time);
+        return item;
+    }
+
+    /** Can be called repeatedly and waits for the delay to expire.
+     *  When the handle is InvalidHandle a new delay is started.
+     *  \param handle is the handle of the delay. Is reset to InvalidHandle when the delay has expired.
+     *  \param time is the delay time in units the TimeT was constructed with.
+     *  \return Returns true to indicate the delay has expired.
+     */
+    static bool Wait(uint8_t &handle, TimeUnitT time)
+    {
+        if (handle == InvalidHandle)
+        {
+            if (time == 0)
+                return true;
+
+            handle = Schedule(time);
+            return false;
+        }
+
+        if (_state[handle] != ItemState::Expired)
+            return false;
+
+        Free(handle);
+        handle = InvalidHandle;
+        return true;
+    }
+
+    /** Indicates if the delay has expired.
+     *  \param handle is the handle of the delay.
+     *  \return Returns true if the delay has expired.
+     */
+    static bool HasExpired(uint8_t handle)
+    {
+        return handle != InvalidHandle && _state[handle] == ItemState::Expired;
+    }
+
+    /** Stops the delay and frees its slot.
+     *  \param handle is the handle of the delay. Is reset to InvalidHandle.
+     */
+    static void Cancel(uint8_t &handle)
+    {
+        if (handle == InvalidHandle)
+            return;
+
+        Free(handle);
+        handle = InvalidHandle;
+    }
+
+    // id based (Delays compatible)
+
+    /** Indicates if the id is listed.
+     *  \param id is the identification of the delay.
+     *  \return Returns true if the id is listed.
+     */
+    static bool IsRunning(uint16_t id)
+    {
+        return Find(id) != NoItem;
+    }
+
+    /** Returns the delay time for the specified id.
+     *  \param id is the identification of the delay.
+     *  \return Returns the remaining delay time in units the TimeT was constructed with.
+     */
+    static TimeUnitT getDelayValue(uint16_t id)
+    {
+        uint8_t item = Find(id);
+        if (item == NoItem)
+            return InvalidId;
+        if (_state[item] != ItemState::Armed)
+            return 0;
+
+        return _expires[item] - _now;
+    }
+
+    /** Zero's out the delay time but keeps the id in the list.
+     *  The next call to Delay will report done.
+     *  \param id is the identification of the delay.
+     */
+    static void Abort(uint16_t id)
+    {
+        uint8_t item = Find(id);
+        if (item == NoItem)
+            return;
+
+        if (_state[item] == ItemState::Armed)
+            Expire(item);
+    }
+
+    /** Can be called repeatedly and will count-down the specified time.
+     *  You must call Update to advance the time.
+     *  When the id is not listed it is added with the specified time.
+     *  \param id is the identification of the delay - cannot be zero (InvalidId).
+     *  \param time is the delay time in units the TimeT was constructed with.
+     *  \return Returns true to indicate the delay has reached zero.
+     */
+    static bool Delay(uint16_t id, TimeUnitT time)
+    {
+        if (id == InvalidId)
+            return false;
+        if (time == 0)
+            return true;
+
+        uint8_t item = Find(id);
+        if (item == NoItem)
+        {
+            item = Allocate();
+            if (item == NoItem)
+                return false;
+
+            _ids[item] = id;
+            Link(item);
+            Arm(item, time);
+            return false;
+        }
+
+        if (_state[item] != ItemState::Expired)
+            return false;
+
+        Free(item);
+        return true;
+    }
+
+    /** Removes the id from the listing.
+     *  \param id is the identification of the delay.
+     */
+    static void Clear(uint16_t id)
+    {
+        uint8_t item = Find(id);
+        if (item != NoItem)
+            Free(item);
+    }
+
+    static TimeUnitT getDelta()
+    {
+        return _delta;
+    }
+
+    /** Retrieves the number of delays that are counting down.
+     */
+    static uint8_t getRunningCount()
+    {
+        return _armedCount;
+    }
+
+private:
+    static TimeUnitT _delta;
+    static uint32_t _now;
+    static uint8_t _armedCount;
+    static uint8_t _freeList;
+    static bool _isInitialized;
+    static bool _isFull;
+
+    // the wheel: list heads per level/slot
+    static uint8_t _slots[Levels * SlotCount];
+
+    // per item
+    static uint32_t _expires[MaxItems];
+    static uint8_t _next[MaxItems];
+    static uint8_t _prev[MaxItems];
+    static uint8_t _slot[MaxItems];
+    static ItemState _state[MaxItems];
+
+    // id lookup
+    static uint16_t _ids[MaxItems];
+    static uint8_t _idNext[MaxItems];
+    static uint8_t _idHeads[HashSize];
+
+    static void Initialize()
+    {
+        for (uint8_t i = 0; i < Levels * SlotCount; i++)
+            _slots[i] = NoItem;
+        for (uint8_t i = 0; i < HashSize; i++)
+            _idHeads[i] = NoItem;
+        for (uint8_t i = 0; i < MaxItems; i++)
+        {
+            _state[i] = ItemState::Free;
+            _ids[i] = InvalidId;
+            _next[i] = i + 1 < MaxItems ? i + 1 : NoItem;
+        }
+
+        _freeList = 0;
+        _now = TimeT::getTicks();
+        _isInitialized = true;
+    }
+
+    static uint8_t Allocate()
+    {
+        if (!_isInitialized)
+            Initialize();
+
+        uint8_t item = _freeList;
+        if (item == NoItem)
+        {
+            // Delay() retries on every call: only report the transition to full
+            if (!_isFull)
+            {
+                _isFull = true;
+                LogWarning<DebugComponentId>("TimerWheel is full.");
+            }
+            return NoItem;
+        }
+
+        _freeList = _next[item];
+        _state[item] = ItemState::Expired;
+        _ids[item] = InvalidId;
+        return item;
+    }
+
+    static void Free(uint8_t item)
+    {
+        if (_state[item] == ItemState::Armed)
+            Detach(item);
+        if (_ids[item] != InvalidId)
+            Unlink(item);
+
+        _state[item] = ItemState::Free;
+        _next[item] = _freeList;
+        _freeList = item;
+        _isFull = false;
+    }
+
+    static void Arm(uint8_t item, TimeUnitT time)
+    {
+        _expires[item] = _now + time;
+        if (time == 0)
+        {
+            _state[item] = ItemState::Expired;
+            return;
+        }
+
+        _state[item] = ItemState::Armed;
+        _armedCount++;
+        Insert(item);
+    }
+
+    static void Expire(uint8_t item)
+    {
+        Detach(item);
+        _state[item] = ItemState::Expired;
+    }
+
+    // places an armed item in the slot for its expiry time
+    static void Insert(uint8_t item)
+    {
+        uint32_t delta = _expires[item] - _now;
+        uint32_t target = delta > MaxSpan ? _now + MaxSpan : _expires[item];
+
+        uint8_t level = 0;
+        while (level < Levels - 1 && delta >= (1UL << ((level + 1) * SlotBits)))
+            level++;
+
+        uint8_t slot = level * SlotCount + ((target >> (level * SlotBits)) & SlotMask);
+        _slot[item] = slot;
+        _prev[item] = NoItem;
+        _next[item] = _slots[slot];
+        if (_next[item] != NoItem)
+            _prev[_next[item]] = item;
+        _slots[slot] = item;
+    }
+
+    // removes an armed item from its slot
+    static void Detach(uint8_t item)
+    {
+        if (_prev[item] == NoItem)
+            _slots[_slot[item]] = _next[item];
+        else
+            _next[_prev[item]] = _next[item];
+        if (_next[item] != NoItem)
+            _prev[_next[item]] = _prev[item];
+
+        _armedCount--;
+    }
+
+    static void Tick()
+    {
+        // cascade the higher levels top-down, so items can move down more than one level at once
+        for (uint8_t level = Levels - 1; level > 0; level--)
+        {
+            uint32_t mask = (1UL << (level * SlotBits)) - 1;
+            if ((_now & mask) == 0)
+                Cascade(level * SlotCount + ((_now >> (level * SlotBits)) & SlotMask));
+        }
+
+        uint8_t slot = _now & SlotMask;
+        uint8_t item = _slots[slot];
+        _slots[slot] = NoItem;
+        while (item != NoItem)
+        {
+            uint8_t next = _next[item];
+            _state[item] = ItemState::Expired;
+            _armedCount--;
+            item = next;
+        }
+    }
+
+    static void Cascade(uint8_t slot)
+    {
+        uint8_t item = _slots[slot];
+        _slots[slot] = NoItem;
+        while (item != NoItem)
+        {
+            uint8_t next = _next[item];
+            Insert(item);
+            item = next;
+        }
+    }
+
+    static uint8_t Hash(uint16_t id)
+    {
+        // ids are typically (even) addresses
+        return ((id >> 1) ^ (id >> 7)) & (HashSize - 1);
+    }
+
+    static uint8_t Find(uint16_t id)
+    {
+        if (!_isInitialized || id == InvalidId)
+            return NoItem;
+
+        uint8_t item = _idHeads[Hash(id)];
+        while (item != NoItem && _ids[item] != id)
+            item = _idNext[item];
+        return item;
+    }
+
+    static void Link(uint8_t item)
+    {
+        uint8_t hash = Hash(_ids[item]);
+        _idNext[item] = _idHeads[hash];
+        _idHeads[hash] = item;
+    }
+
+    static void Unlink(uint8_t item)
+    {
+        uint8_t hash = Hash(_ids[item]);
+        if (_idHeads[hash] == item)
+            _idHeads[hash] = _idNext[item];
+        else
+        {
+            uint8_t prev = _idHeads[hash];
+            while (_idNext[prev] != item)
+                prev = _idNext[prev];
+            _idNext[prev] = _idNext[item];
+        }
+
+        _ids[item] = InvalidId;
+    }
+
+    TimerWheel() {}
+};
+
+template <class TimeT, const uint8_t MaxItems, typename TimeUnitT>
+uint16_t TimerWheel<TimeT, MaxItems, TimeUnitT>::InvalidId = 0;
+
+template <class TimeT, const uint8_t MaxItems, typename TimeUnitT>
+TimeUnitT TimerWheel<TimeT, MaxItems, TimeUnitT>::_delta;
+template <class TimeT, const uint8_t MaxItems, typename TimeUnitT>
+uint32_t TimerWheel<TimeT, MaxItems, TimeUnitT>::_now = 0;
+template <class TimeT, const uint8_t MaxItems, typename TimeUnitT>
+uint8_t TimerWheel<TimeT, MaxItems, TimeUnitT>::_armedCount = 0;
+template <class TimeT, const uint8_t MaxItems, typename TimeUnitT>
+uint8_t TimerWheel<TimeT, MaxItems, TimeUnitT>::_freeList = 0;
+template <class TimeT, const uint8_t MaxItems, typename TimeUnitT>
+bool TimerWheel<TimeT, MaxItems, TimeUnitT>::_isInitialized = false;
+template <class TimeT, const uint8_t MaxItems, typename TimeUnitT>
+bool TimerWheel<TimeT, MaxItems, TimeUnitT>::_isFull = false;
+
+template <class TimeT, const uint8_t MaxItems, typename TimeUnitT>
+uint8_t TimerWheel<TimeT, MaxItems, TimeUnitT>::_slots[] = {};
+
+template <class TimeT, const uint8_t MaxItems, typename TimeUnitT>
+uint32_t TimerWheel<TimeT, MaxItems, TimeUnitT>::_expires[] = {};
+template <class TimeT, const uint8_t MaxItems, typename TimeUnitT>
+uint8_t TimerWheel<TimeT, MaxItems, TimeUnitT>::_next[] = {};
+template <class TimeT, const uint8_t MaxItems, typename TimeUnitT>
+uint8_t TimerWheel<TimeT, MaxItems, TimeUnitT>::_prev[] = {};
+template <class TimeT, const uint8_t MaxItems, typename TimeUnitT>
+uint8_t TimerWheel<TimeT, MaxItems, TimeUnitT>::_slot[] = {};
+template <class TimeT, const uint8_t MaxItems, typename TimeUnitT>
+typename TimerWheel<TimeT, MaxItems, TimeUnitT>::ItemState TimerWheel<TimeT, MaxItems, TimeUnitT>::_state[] = {};
+
+template <class TimeT, const uint8_t MaxItems, typename TimeUnitT>
+uint16_t TimerWheel<TimeT, MaxItems, TimeUnitT>::_ids[] = {};
+template <class TimeT, const uint8_t MaxItems, typename TimeUnitT>
+uint8_t TimerWheel<TimeT, MaxItems, TimeUnitT>::_idNext[] = {};
+template <class TimeT, const uint8_t MaxItems, typename TimeUnitT>
+uint8_t TimerWheel<TimeT, MaxItems, TimeUnitT>::_idHeads[] = {};
@@ -0,0 +1,204 @@
+#pragma once
+#include <stdint.h>
+#include "../lib/atl/AtlMath.h"
+#include "../lib/atl/Task.h"
+
+/** The NoApproach stops a block immediately (hard cut to 0).
+ *  It is the default stop behavior for the BlockDriverTask.
+ */
+class NoApproach
+{
+public:
+    bool Open()
+    {
+        return true;
+    }
+
+    template <class BlockT>
+    void Brake(BlockT &block, uint8_t speed)
+    {
+        (void)speed;
+        block.setSpeed(0);
+    }
+
+    void Release()
+    {
+    }
+
+    template <class BlockT>
+    bool Run(BlockT &block)
+    {
+        (void)block;
+        return true;
+    }
+};
+
+/** The ApproachControl brakes a train to a halt at a set mark at the end of a stop block.
+ *  A (ToF) range sensor at the end of the block measures the distance to the train.
+ *  When braking starts the remaining distance and the current speed determine a
+ *  constant deceleration profile: speed = startSpeed * sqrt(distance / startDistance).
+ *  The range sensor must run in continuous mode; Run only reads a finished measurement
+ *  and never waits for one, so the main loop is not blocked.
+ *  The speed is halved when braking starts, so the train has slowed down before the first reading.
+ *  When the sensor does not see the train (dropout, reflective stock, a failed I2C read)
+ *  for MaxMissedReadings polls in a row, the block is stopped hard.
+ *  \tparam SchedulerT is the Delays<> type used to pace the sensor reads.
+ *  \tparam RangeSensorT is the range sensor (VL53L0X). It implements
+ *  `bool Open()`, `bool StartContinuous(uint32_t)`, `bool StopContinuous()` and `bool ReadRange_mm(uint16_t*)`.
+ *  \tparam StopMark_mm is the distance (mm) from the sensor at which the train should halt.
+ *  \tparam CrawlSpeed is the minimal speed that still moves the train. Used until the mark is reached.
+ */
+template <class SchedulerT, class RangeSensorT, const uint16_t StopMark_mm, const uint8_t CrawlSpeed = 40>
+class ApproachControl
+{
+    // the sensor reports 8190/8191 when nothing is in range
+    static const uint16_t MaxRange_mm = 2000;
+    // the sensor measures every ~33ms in back-to-back mode
+    static const uint16_t PollPeriod_ms = 20;
+    // polls without a valid reading before the block is stopped hard (~200ms)
+    static const uint8_t MaxMissedReadings = 10;
+
+public:
+    enum class State : uint8_t
+    {
+        Idle,     // not braking, the sensor is not read
+        Braking,  // waiting for the first reading
+        Tracking, // following the deceleration profile
+        Stopped,  // the train has halted at the mark
+    };
+
+    ApproachControl()
+        : _task(0), _state(State::Idle), _startDistance(0), _startSpeed(0), _speed(0), _missedReadings(0)
+    {
+    }
+
+    /** Opens the range sensor and starts continuous (back-to-back) measurements.
+     *  \return Returns false if the sensor could not be initialized.
+     */
+    bool Open()
+    {
+        return _sensor.Open() &&
+               _sensor.StartContinuous();
+    }
+
+    /** Starts braking the train in the block: the speed is reduced at once.
+     *  The deceleration profile is computed at the first range reading.
+     *  \param block is the stop block.
+     *  \param speed is the current speed of the train.
+     */
+    template <class BlockT>
+    void Brake(BlockT &block, uint8_t speed)
+    {
+        if (_state != State::Idle)
+            return;
+
+        uint8_t entrySpeed = speed / 2;
+        if (entrySpeed < CrawlSpeed)
+            entrySpeed = speed < CrawlSpeed ? speed : CrawlSpeed;
+
+        _startSpeed = entrySpeed;
+        _speed = entrySpeed;
+        _missedReadings = 0;
+        _state = State::Braking;
+        block.setSpeed(entrySpeed);
+    }
+
+    /** Stops approach control. The block speed is not changed.
+     */
+    void Release()
+    {
+        SchedulerT::Abort(getId());
+        _task = 0;
+        _state = State::Idle;
+    }
+
+    /** Call repeatedly from the main loop.
+     *  When braking, reads the range sensor (if a measurement is available) and adjusts the block speed.
+     *  \param block is the stop block.
+     */
+    template <class BlockT>
+    Task_BeginParams(Run, BlockT &block)
+    {
+        while (true)
+        {
+            Task_WaitUntil(_state == State::Braking || _state == State::Tracking);
+            Task_WaitUntil(SchedulerT::Delay(getId(), SchedulerT::ForMilliseconds(PollPeriod_ms)));
+            Update(block);
+        }
+    }
+    Task_End;
+
+    State getState() const
+    {
+        return _state;
+    }
+
+    bool getIsStopped() const
+    {
+        return _state == State::Stopped;
+    }
+
+    uint16_t getId() const
+    {
+        return (uint16_t)this;
+    }
+
+private:
+    uint16_t _task;
+    State _state;
+    uint16_t _startDistance;
+    uint8_t _startSpeed;
+    uint8_t _speed;
+    uint8_t _missedReadings;
+    RangeSensorT _sensor;
+
+    template <class BlockT>
+    void Update(BlockT &block)
+    {
+        uint16_t range = 0;
+        if (!_sensor.ReadRange_mm(&range) || range > MaxRange_mm)
+        {
+            // never run blind into the occupied block
+            if (++_missedReadings >= MaxMissedReadings)
+            {
+                _speed = 0;
+                block.setSpeed(0);
+                _state = State::Stopped;
+            }
+            return;
+        }
+        _missedReadings = 0;
+
+        uint16_t distance = range > StopMark_mm ? range - StopMark_mm : 0;
+
+        if (_state == State::Braking)
+        {
+            _startDistance = distance;
+            _state = State::Tracking;
+        }
+
+        uint8_t speed = CalculateSpeed(distance);
+        // never accelerate on a noisy reading
+        if (speed < _speed)
+            _speed = speed;
+
+        block.setSpeed(_speed);
+
+        if (_speed == 0)
+            _state = State::Stopped;
+    }
+
+    // speed^2 is proportional to the remaining distance at constant deceleration.
+    uint8_t CalculateSpeed(uint16_t distance) const
+    {
+        if (distance == 0 || _startDistance == 0)
+            return 0;
+        if (distance >= _startDistance)
+            return _startSpeed;
+
+        uint32_t speedSquared = ((uint32_t)_startSpeed * _startSpeed * distance) / _startDistance;
+        uint8_t speed = (uint8_t)Math::Sqrt(speedSquared);
+
+        return speed < CrawlSpeed ? CrawlSpeed : speed;
+    }
+};
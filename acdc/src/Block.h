@@ -3,17 +3,27 @@
 #include "../lib/atl/Collection.h"
 #include "../lib/atl/FixedArray.h"
 #include "../lib/atl/Task.h"
+#include "../lib/atl/Time.h"
 #include "OptoBlockController.h"
 #include "CurrentBlockController.h"
 #include "hardware.h"
 #include "Serial.h"
+#include "OccupancyEvents.h"
 
 extern Serial serial;
 
-template <class BlockControllerT>
+/** A Block reads its occupancy and publishes an OccupancyEvent when it changes.
+ *  \tparam BlockControllerT is the controller that detects occupancy.
+ *  \tparam BlockId is the zero-based index of the block.
+ */
+template <class BlockControllerT, const uint8_t BlockId>
 class Block : public BlockControllerT
 {
 public:
+    /** Reads the occupancy of the block.
+     *  A change is published to the occupancyEvents queue.
+     *  \return Returns true if the occupancy has changed.
+     */
     bool TryReadOccupied()
     {
         // int16_t val = 0;
@@ -39,6 +49,12 @@ public:
         if (_occupied != on)
         {
             _occupied = on;
+
+            OccupancyEvent event;
+            event.BlockId = BlockId;
+            event.Occupied = on;
+            event.Timestamp = Time<TimeResolution::Milliseconds>::getTicks();
+            occupancyEvents.Publish(event);
             return true;
         }
 
@@ -50,6 +66,11 @@ public:
         return _occupied;
     }
 
+    uint8_t getBlockId() const
+    {
+        return BlockId;
+    }
+
     // void Dump()
     // {
     //     for (int16_t i = 0; i < occupiedValues.getCount(); i++)
@@ -84,12 +105,12 @@ private:
     // }
 };
 
-typedef Block<CurrentBlockController<MotorControllerT_0, Ina219T_0>> BlockControllerT_0;
-typedef Block<CurrentBlockController<MotorControllerT_1, Ina219T_1>> BlockControllerT_1;
-typedef Block<CurrentBlockController<MotorControllerT_2, Ina219T_2>> BlockControllerT_2;
-typedef Block<CurrentBlockController<MotorControllerT_3, Ina219T_3>> BlockControllerT_3;
+typedef Block<CurrentBlockController<MotorControllerT_0, Ina219T_0>, 0> BlockControllerT_0;
+typedef Block<CurrentBlockController<MotorControllerT_1, Ina219T_1>, 1> BlockControllerT_1;
+typedef Block<CurrentBlockController<MotorControllerT_2, Ina219T_2>, 2> BlockControllerT_2;
+typedef Block<CurrentBlockController<MotorControllerT_3, Ina219T_3>, 3> BlockControllerT_3;
 
-// typedef Block<OptoBlockController<MotorControllerT_0, PortPins::C0>> BlockControllerT_0;
-// typedef Block<OptoBlockController<MotorControllerT_1, PortPins::C1>> BlockControllerT_1;
-// typedef Block<OptoBlockController<MotorControllerT_2, PortPins::C2>> BlockControllerT_2;
-// typedef Block<OptoBlockController<MotorControllerT_3, PortPins::C3>> BlockControllerT_3;
+// typedef Block<OptoBlockController<MotorControllerT_0, PortPins::C0>, 0> BlockControllerT_0;
+// typedef Block<OptoBlockController<MotorControllerT_1, PortPins::C1>, 1> BlockControllerT_1;
+// typedef Block<OptoBlockController<MotorControllerT_2, PortPins::C2>, 2> BlockControllerT_2;
+// typedef Block<OptoBlockController<MotorControllerT_3, PortPins::C3>, 3> BlockControllerT_3;
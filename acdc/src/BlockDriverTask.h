@@ -4,15 +4,21 @@
 #include "../lib/atl/FixedArray.h"
 #include "../lib/atl/Task.h"
 #include "Block.h"
+#include "ApproachControl.h"
 // #include "CurrentBlockController.h"
 #include "OptoBlockController.h"
+#include "TrainTracker.h"
+#include "OccupancyEvents.h"
 #include "hardware.h"
 #include "Serial.h"
 
 extern Serial serial;
+extern TrainTrackerT trainTracker;
+extern OccupancyEventQueue occupancyEvents;
 
 // Controls the StopBlock based on the state of the PrioBlock
-template <class SchedulerT, class StopBlockT, class PrioBlockT>
+// ApproachT determines how the StopBlock is stopped: NoApproach (hard stop) or ApproachControl (brake to a mark).
+template <class SchedulerT, class StopBlockT, class PrioBlockT, class ApproachT = NoApproach>
 class BlockDriverTask
 {
 public:
@@ -21,6 +27,11 @@ public:
         _state = State::Running;
     }
 
+    bool Open()
+    {
+        return _approach.Open();
+    }
+
     enum class State : uint8_t
     {
         Conflict, // detected both block occupied
@@ -38,15 +49,51 @@ public:
 
     Task_BeginParams(Run, StopBlockT &stopBlock, PrioBlockT &prioBlock, const char *stopMessage)
     {
-        bool stopOccupied = stopBlock.getOccupied();
-        bool prioOccupied = prioBlock.getOccupied();
-
         if (_state == State::Conflict)
         {
             // could be the train transitioning from stopBlock to prioBlok, so wait a bit
-            Task_WaitUntil(SchedulerT::Delay((uint16_t)stopMessage, SchedulerT::ForMilliseconds(200)));
+            Task_WaitUntil(SchedulerT::Delay(getId(), SchedulerT::ForMilliseconds(200)));
         }
 
+        Update(stopBlock, prioBlock, stopMessage);
+    }
+    Task_End;
+
+    // lets the approach control follow the train to the stop mark.
+    void RunApproach(StopBlockT &stopBlock)
+    {
+        _approach.Run(stopBlock);
+    }
+
+    uint16_t getId() const
+    {
+        return (uint16_t)this;
+    }
+
+    void setSpeed(uint8_t speed)
+    {
+        _speed = speed;
+    }
+
+    bool getIsStopped() const
+    {
+        return _state == State::Stopped;
+    }
+
+private:
+    uint16_t _task;
+    State _state;
+    uint8_t _speed;
+    uint32_t _time;
+    ApproachT _approach;
+
+    // reads the (current) occupancy after the wait - a Task cannot keep locals across a wait.
+    void Update(StopBlockT &stopBlock, PrioBlockT &prioBlock, const char *stopMessage)
+    {
+        (void)stopMessage;
+        bool stopOccupied = stopBlock.getOccupied();
+        bool prioOccupied = prioBlock.getOccupied();
+
         if (_state == State::Stopped)
         {
             // previously stopped
@@ -54,6 +101,7 @@ public:
             {
                 // we are stopped but the next block has cleared
                 // we can start again
+                _approach.Release();
                 stopBlock.setSpeed(_speed);
                 _state = State::Running;
             }
@@ -63,7 +111,7 @@ public:
             // are they still both occupied?
             if (stopOccupied && prioOccupied)
             {
-                stopBlock.setSpeed(0);
+                _approach.Brake(stopBlock, _speed);
                 _state = State::Stopped;
 
                 // serial.Transmit.WriteLine(stopMessage);
@@ -77,23 +125,6 @@ public:
             }
         }
     }
-    Task_End;
-
-    uint16_t getId() const
-    {
-        return (uint16_t)this;
-    }
-
-    void setSpeed(uint8_t speed)
-    {
-        _speed = speed;
-    }
-
-private:
-    uint16_t _task;
-    State _state;
-    uint8_t _speed;
-    uint32_t _time;
 };
 
 template <class SchedulerT>
@@ -123,36 +154,27 @@ public:
             _detected = true;
         }
 
+        // the blocks are read (and their changes published) by the main loop.
         while (true)
         {
-            if (block0.TryReadOccupied() ||
-                block1.TryReadOccupied() ||
-                block2.TryReadOccupied() ||
-                block3.TryReadOccupied())
-            {
-                // serial.Transmit.Write(block0.getOccupied());
-                // serial.Transmit.Write(block1.getOccupied());
-                // serial.Transmit.Write(block2.getOccupied());
-                // serial.Transmit.WriteLine(block3.getOccupied());
-
-                _blockDriver0.Run(block0, block1, "Stop 0");
-                _blockDriver1.Run(block1, block2, "Stop 1");
-                _blockDriver2.Run(block2, block3, "Stop 2");
-                _blockDriver3.Run(block3, block0, "Stop 3");
-            }
-            else
-            {
-                _blockDriver0.AdditionalProcessing(block0, block1, "Stop 0");
-                _blockDriver1.AdditionalProcessing(block1, block2, "Stop 1");
-                _blockDriver2.AdditionalProcessing(block2, block3, "Stop 2");
-                _blockDriver3.AdditionalProcessing(block3, block0, "Stop 3");
-            }
+            ProcessEvents(block0, block1, block2, block3);
+
+            // let the train settings follow the trains into their new blocks
+            ApplyTrains(block0, block1, block2, block3);
 
             Task_Yield();
         }
     }
     Task_End;
 
+    bool Open()
+    {
+        return _blockDriver0.Open() &&
+               _blockDriver1.Open() &&
+               _blockDriver2.Open() &&
+               _blockDriver3.Open();
+    }
+
     void setSpeed(uint8_t speed)
     {
         _speed = speed;
@@ -164,11 +186,86 @@ public:
     }
 
 private:
+    // each occupancy event is processed once, by the drivers that have the block as stop or prio block.
+    // the other drivers only continue a pending conflict.
+    void ProcessEvents(BlockControllerT_0 &block0, BlockControllerT_1 &block1, BlockControllerT_2 &block2, BlockControllerT_3 &block3)
+    {
+        uint8_t drivers = 0;
+        OccupancyEvent event;
+        while (occupancyEvents.TryRead((uint8_t)OccupancySubscriber::BlockLogic, &event))
+        {
+            trainTracker.OnOccupiedChanged(event.BlockId, event.Occupied, event.Timestamp);
+
+            // driver n stops block n and gives priority to block n+1
+            BitFlag::Set(drivers, event.BlockId);
+            BitFlag::Set(drivers, (event.BlockId + 3) & 0x03);
+        }
+
+        // events were lost: bring the tracker in line with the blocks and run all drivers
+        if (occupancyEvents.TryTakeOverrun((uint8_t)OccupancySubscriber::BlockLogic))
+        {
+            trainTracker.OnOccupiedChanged(0, block0.getOccupied());
+            trainTracker.OnOccupiedChanged(1, block1.getOccupied());
+            trainTracker.OnOccupiedChanged(2, block2.getOccupied());
+            trainTracker.OnOccupiedChanged(3, block3.getOccupied());
+            drivers = 0x0F;
+        }
+
+        RunDriver(drivers, 0, _blockDriver0, block0, block1, "Stop 0");
+        RunDriver(drivers, 1, _blockDriver1, block1, block2, "Stop 1");
+        RunDriver(drivers, 2, _blockDriver2, block2, block3, "Stop 2");
+        RunDriver(drivers, 3, _blockDriver3, block3, block0, "Stop 3");
+    }
+
+    template <class BlockDriverT, class StopBlockT, class PrioBlockT>
+    void RunDriver(uint8_t drivers, uint8_t driverIndex, BlockDriverT &blockDriver, StopBlockT &stopBlock, PrioBlockT &prioBlock, const char *stopMessage)
+    {
+        if (BitFlag::IsTrue(drivers, driverIndex))
+            blockDriver.Run(stopBlock, prioBlock, stopMessage);
+        else
+            blockDriver.AdditionalProcessing(stopBlock, prioBlock, stopMessage);
+
+        blockDriver.RunApproach(stopBlock);
+    }
+
+    void ApplyTrains(BlockControllerT_0 &block0, BlockControllerT_1 &block1, BlockControllerT_2 &block2, BlockControllerT_3 &block3)
+    {
+        uint8_t changedBlocks = 0;
+        if (!trainTracker.TryTakeChangedBlocks(&changedBlocks))
+            return;
+
+        ApplyTrain(changedBlocks, 0, block0, _blockDriver0);
+        ApplyTrain(changedBlocks, 1, block1, _blockDriver1);
+        ApplyTrain(changedBlocks, 2, block2, _blockDriver2);
+        ApplyTrain(changedBlocks, 3, block3, _blockDriver3);
+    }
+
+    template <class BlockT, class BlockDriverT>
+    void ApplyTrain(uint8_t changedBlocks, uint8_t blockIndex, BlockT &block, BlockDriverT &blockDriver)
+    {
+        const Train *train = nullptr;
+        if (!BitFlag::IsTrue(changedBlocks, blockIndex) ||
+            !trainTracker.TryGetTrain(blockIndex, &train))
+            return;
+
+        block.setDirection(train->Dir);
+        blockDriver.setSpeed(train->Speed.Cruise);
+
+        // a stopped block picks up the new speed when it starts again
+        if (!blockDriver.getIsStopped())
+            block.setSpeed(train->Speed.Cruise);
+    }
+
     bool _detected;
     uint8_t _speed;
-    uint8_t _task;
+    uint16_t _task;
 
+#ifdef APPROACH_CONTROL
+    // brake to a halt 50mm before the ToF sensor at the end of block 0
+    BlockDriverTask<SchedulerT, BlockControllerT_0, BlockControllerT_1, ApproachControl<SchedulerT, VL53L0XT_0, 50>> _blockDriver0;
+#else
     BlockDriverTask<SchedulerT, BlockControllerT_0, BlockControllerT_1> _blockDriver0;
+#endif
     BlockDriverTask<SchedulerT, BlockControllerT_1, BlockControllerT_2> _blockDriver1;
     BlockDriverTask<SchedulerT, BlockControllerT_2, BlockControllerT_3> _blockDriver2;
     BlockDriverTask<SchedulerT, BlockControllerT_3, BlockControllerT_0> _blockDriver3;
@@ -1,24 +1,225 @@
 #pragma once
 #include <stdint.h>
+#include <avr/pgmspace.h>
 
 #include "Commands.h"
 
-// command: the basic command ids
-// data: a buffer with command parameter data
-// typedCommand: receives a pointer to the typed command
-// return: true when successfull - typedCommand is filled (non-null).
-bool TryBuildTypedCommand(Command &command, Slice<uint8_t> &data, Command **typedCommand)
+/** A list of command types (structs with a static Message and ParameterLength, see Commands.h). */
+template <class... CommandTs>
+struct CommandList
 {
-    // global commands
-    if (GlobalCommand::TryCreate(command, data, (GlobalCommand **)typedCommand))
-        return true;
+};
+
+/** The global commands (NodeId and DeviceId are NoneId). */
+typedef CommandList<GlobalResetCommand> GlobalCommands;
+/** The node commands. */
+typedef CommandList<BlockPowerCommand, BlockSpeedCommand, TrainAssignCommand, TrainSpeedCommand,
+                    BlockSpeedBatchCommand, BlockPowerMaskCommand>
+    NodeCommands;
+
+// compile time helpers for the CommandDispatchTable ------------------------------
+
+template <uint8_t... Indices>
+struct CommandIndexList
+{
+};
+
+template <uint16_t Count, uint8_t... Indices>
+struct CommandMakeIndexList : CommandMakeIndexList<Count - 1, Count - 1, Indices...>
+{
+};
+template <uint8_t... Indices>
+struct CommandMakeIndexList<0, Indices...>
+{
+    typedef CommandIndexList<Indices...> Type;
+};
+
+template <bool Condition, class TrueT, class FalseT>
+struct CommandSelect
+{
+    typedef TrueT Type;
+};
+template <class TrueT, class FalseT>
+struct CommandSelect<false, TrueT, FalseT>
+{
+    typedef FalseT Type;
+};
+
+template <class CommandT>
+constexpr uint8_t CommandMessageId()
+{
+    return static_cast<uint8_t>(CommandT::Message);
+}
+
+// the lowest and highest MessageId in the list
+template <class... CommandTs>
+struct CommandIdRange;
+template <class CommandT>
+struct CommandIdRange<CommandT>
+{
+    static const uint8_t Min = CommandMessageId<CommandT>();
+    static const uint8_t Max = CommandMessageId<CommandT>();
+};
+template <class CommandT, class... CommandTs>
+struct CommandIdRange<CommandT, CommandTs...>
+{
+    static const uint8_t Min = CommandMessageId<CommandT>() < CommandIdRange<CommandTs...>::Min ? CommandMessageId<CommandT>() : CommandIdRange<CommandTs...>::Min;
+    static const uint8_t Max = CommandMessageId<CommandT>() > CommandIdRange<CommandTs...>::Max ? CommandMessageId<CommandT>() : CommandIdRange<CommandTs...>::Max;
+};
 
-    // node commands
-    if (NodeCommand::TryCreate(command, data, (NodeCommand **)typedCommand))
+// the number of commands in the list with the MessageId
+template <uint8_t Id, class... CommandTs>
+struct CommandIdCount
+{
+    static const uint8_t Value = 0;
+};
+template <uint8_t Id, class CommandT, class... CommandTs>
+struct CommandIdCount<Id, CommandT, CommandTs...>
+{
+    static const uint8_t Value = (CommandMessageId<CommandT>() == Id ? 1 : 0) + CommandIdCount<Id, CommandTs...>::Value;
+};
+
+template <class... CommandTs>
+struct CommandIdsUnique
+{
+    static const bool Value = true;
+};
+template <class CommandT, class... CommandTs>
+struct CommandIdsUnique<CommandT, CommandTs...>
+{
+    static const bool Value = CommandIdCount<CommandMessageId<CommandT>(), CommandTs...>::Value == 0 &&
+                              CommandIdsUnique<CommandTs...>::Value;
+};
+
+template <class HandlerT>
+struct CommandDispatchEntry
+{
+    typedef bool (*DispatchFunction)(HandlerT &handler, const Command &command, const uint8_t *data, uint8_t length);
+
+    DispatchFunction Function;
+    uint8_t ParameterLength;
+};
+
+// decodes the command on the stack and passes it to the handler
+template <class HandlerT, class CommandT, bool Variable = CommandT::ParameterLength == VariableParameterLength>
+struct CommandDispatcher
+{
+    static bool Dispatch(HandlerT &handler, const Command &command, const uint8_t *data, uint8_t /*length*/)
+    {
+        CommandT typedCommand;
+        typedCommand.Take(command);
+        typedCommand.Deserialize(data);
+        if (!typedCommand.IsValid())
+            return false;
+        handler.OnCommand(&typedCommand);
+        return true;
+    }
+};
+// the command validates the length itself
+template <class HandlerT, class CommandT>
+struct CommandDispatcher<HandlerT, CommandT, true>
+{
+    static bool Dispatch(HandlerT &handler, const Command &command, const uint8_t *data, uint8_t length)
+    {
+        CommandT typedCommand;
+        typedCommand.Take(command);
+        if (!typedCommand.TryDeserialize(data, length))
+            return false;
+        handler.OnCommand(&typedCommand);
         return true;
+    }
+};
+
+// the table entry for a MessageId: the command with that id or an empty entry
+template <class HandlerT, uint8_t Id>
+struct CommandNoEntry
+{
+    static constexpr typename CommandDispatchEntry<HandlerT>::DispatchFunction Function = nullptr;
+    static const uint8_t ParameterLength = 0;
+};
+template <class HandlerT, class CommandT>
+struct CommandFoundEntry
+{
+    static constexpr typename CommandDispatchEntry<HandlerT>::DispatchFunction Function = &CommandDispatcher<HandlerT, CommandT>::Dispatch;
+    static const uint8_t ParameterLength = CommandT::ParameterLength;
+};
+template <class HandlerT, uint8_t Id, class... CommandTs>
+struct CommandEntry : CommandNoEntry<HandlerT, Id>
+{
+};
+template <class HandlerT, uint8_t Id, class CommandT, class... CommandTs>
+struct CommandEntry<HandlerT, Id, CommandT, CommandTs...>
+    : CommandSelect<CommandMessageId<CommandT>() == Id,
+                    CommandFoundEntry<HandlerT, CommandT>,
+                    CommandEntry<HandlerT, Id, CommandTs...>>::Type
+{
+};
+
+template <class HandlerT, uint8_t MinId, class IndexListT, class... CommandTs>
+struct CommandDispatchEntries;
+template <class HandlerT, uint8_t MinId, uint8_t... Indices, class... CommandTs>
+struct CommandDispatchEntries<HandlerT, MinId, CommandIndexList<Indices...>, CommandTs...>
+{
+    static const CommandDispatchEntry<HandlerT> Values[sizeof...(Indices)];
+};
+template <class HandlerT, uint8_t MinId, uint8_t... Indices, class... CommandTs>
+const CommandDispatchEntry<HandlerT> CommandDispatchEntries<HandlerT, MinId, CommandIndexList<Indices...>, CommandTs...>::Values[sizeof...(Indices)] PROGMEM = {
+    {CommandEntry<HandlerT, MinId + Indices, CommandTs...>::Function,
+     CommandEntry<HandlerT, MinId + Indices, CommandTs...>::ParameterLength}...};
+
+// --------------------------------------------------------------------------------
+
+/** The CommandDispatchTable decodes a command with a single indexed lookup: the table holds a
+ *  (PROGMEM) entry for each MessageId from the lowest to the highest id in the CommandList, with
+ *  the decode function and the expected parameter length. The table is generated at compile time,
+ *  a new command is only added to the CommandList.
+ *  The command is decoded on the stack and passed to `HandlerT::OnCommand(CommandT *)`.
+ *  A command with a VariableParameterLength checks the length in its TryDeserialize,
+ *  a command with a fixed ParameterLength checks its parameters in IsValid.
+ *  CommandDispatchTable is a static class and cannot be instantiated.
+ *  \tparam HandlerT implements an `OnCommand(CommandT *)` overload for each command in the list.
+ *  \tparam CommandListT is a CommandList.
+ */
+template <class HandlerT, class CommandListT>
+class CommandDispatchTable;
+
+template <class HandlerT, class... CommandTs>
+class CommandDispatchTable<HandlerT, CommandList<CommandTs...>>
+{
+public:
+    static const uint8_t MinId = CommandIdRange<CommandTs...>::Min;
+    static const uint8_t MaxId = CommandIdRange<CommandTs...>::Max;
+    static const uint16_t Count = (uint16_t)MaxId - MinId + 1;
+
+    /** Decodes the command and calls the handler.
+     *  \param handler receives the typed command.
+     *  \param command holds the NodeId, DeviceId and MessageId.
+     *  \param data is the parameter data.
+     *  \param length is the number of bytes in data.
+     *  \return Returns false if the MessageId is unknown or the parameters do not match the command.
+     */
+    static bool TryDispatch(HandlerT &handler, const Command &command, const uint8_t *data, uint8_t length)
+    {
+        uint8_t index = command.MessageId - MinId;
+        if (command.MessageId < MinId || index >= Count)
+            return false;
+
+        const CommandDispatchEntry<HandlerT> *entry = &EntriesT::Values[index];
+        typename CommandDispatchEntry<HandlerT>::DispatchFunction function =
+            reinterpret_cast<typename CommandDispatchEntry<HandlerT>::DispatchFunction>(pgm_read_ptr(&entry->Function));
+        if (function == nullptr)
+            return false;
+        uint8_t expected = pgm_read_byte(&entry->ParameterLength);
+        if (expected != VariableParameterLength && expected != length)
+            return false;
+
+        return function(handler, command, data, length);
+    }
+
+private:
+    typedef CommandDispatchEntries<HandlerT, MinId, typename CommandMakeIndexList<Count>::Type, CommandTs...> EntriesT;
 
-    // device commands
+    static_assert(CommandIdsUnique<CommandTs...>::Value, "CommandDispatchTable: each command needs a unique MessageId.");
 
-    *typedCommand = nullptr;
-    return false;
+    CommandDispatchTable() {}
 };
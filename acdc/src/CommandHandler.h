@@ -3,8 +3,10 @@
 
 #include "Block.h"
 #include "Commands.h"
+#include "TrainTracker.h"
 
 extern Serial serial;
+extern TrainTrackerT trainTracker;
 
 BlockControllerT_0 blockController0;
 BlockControllerT_1 blockController1;
@@ -93,4 +95,49 @@ protected:
 
         // serial.Transmit.WriteLine(command->Speed);
     }
+    void OnCommand(TrainAssignCommand *command)
+    {
+        // BlockId is one-based
+        if (command->BlockId == 0)
+            return;
+
+        SpeedProfile speed = {command->Speed};
+        trainTracker.Assign(command->BlockId - 1, command->TrainId,
+                            command->Forward ? Direction::Forward : Direction::Backward, speed);
+    }
+    void OnCommand(TrainSpeedCommand *command)
+    {
+        SpeedProfile speed = {command->Speed};
+        trainTracker.setSpeed(command->TrainId, speed);
+    }
+    // all blocks change together: one PCA9685 transaction
+    void OnCommand(BlockSpeedBatchCommand *command)
+    {
+        uint8_t mask = command->BlockMask;
+        PwmModuleT::BeginBatch();
+        if (mask & 0x01)
+            blockController0.setSpeed(command->Speeds[0]);
+        if (mask & 0x02)
+            blockController1.setSpeed(command->Speeds[1]);
+        if (mask & 0x04)
+            blockController2.setSpeed(command->Speeds[2]);
+        if (mask & 0x08)
+            blockController3.setSpeed(command->Speeds[3]);
+        PwmModuleT::CommitBatch();
+    }
+    void OnCommand(BlockPowerMaskCommand *command)
+    {
+        uint8_t mask = command->BlockMask;
+        uint8_t power = command->PowerFlags;
+        PwmModuleT::BeginBatch();
+        if (mask & 0x01)
+            blockController0.setPower((power & 0x01) != 0);
+        if (mask & 0x02)
+            blockController1.setPower((power & 0x02) != 0);
+        if (mask & 0x04)
+            blockController2.setPower((power & 0x04) != 0);
+        if (mask & 0x08)
+            blockController3.setPower((power & 0x08) != 0);
+        PwmModuleT::CommitBatch();
+    }
 };
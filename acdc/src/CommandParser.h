@@ -14,6 +14,9 @@ template <class CommandHandlerT>
 class CommandParser : public CommandHandlerT
 {
 public:
+    /** Parameters are binary: every byte value can occur, none is reserved for the e-stop. */
+    static const bool IsTextProtocol = false;
+
     enum class ParserState : uint8_t
     {
         Idle,
@@ -32,11 +35,6 @@ public:
         InvalidParameter
     };
 
-    CommandParser()
-        : _slice(_params.getBuffer(), _params.getCapacity())
-    {
-    }
-
     bool Parse(uint8_t data)
     {
         switch (_state)
@@ -112,30 +110,16 @@ public:
 
     bool Dispatch()
     {
-        // build typed command
-        Command *typedCommand = nullptr;
-        if (!TryBuildTypedCommand(_command, _slice, &typedCommand))
-        {
-            // serial.Transmit.WriteLine("TypedCmd Failed");
+        if (_state != ParserState::Complete)
             return false;
-        }
-        // global commands
-        if (OnGlobalCommand<GlobalResetCommand>(typedCommand, GlobalMessages::Reset))
-            return true;
-
-        // node commands
-        // if (OnNodeCommand<NodeResetCommand>(typedCommand, NodeMessages::Reset))
-        //     return true;
-        if (OnNodeCommand<BlockPowerCommand>(typedCommand, NodeMessages::BlockPower))
-            return true;
-        if (OnNodeCommand<BlockSpeedCommand>(typedCommand, NodeMessages::BlockSpeed))
-            return true;
 
-        // device commands
-        // if (OnDeviceCommand(typedCommand, DeviceMessages::Reset))
-        //     return true;
+        // a single table lookup per message group (validates the parameter length)
+        if (_command.IsGlobalCommand())
+            return GlobalDispatchTable::TryDispatch(*this, _command, _params.getBuffer(), _params.getCount());
+        if (_command.IsNodeCommand())
+            return NodeDispatchTable::TryDispatch(*this, _command, _params.getBuffer(), _params.getCount());
 
-        // serial.Transmit.WriteLine("No Dispatch");
+        // device commands: none yet
         return false;
     }
 
@@ -164,46 +148,39 @@ public:
         return _state == ParserState::Complete;
     }
 
-private:
-    ParserState _state = ParserState::Idle;
-    ParserError _error = ParserError::NoError;
-    Command _command;
-    Collection<FixedArray<uint8_t, 8>> _params;
-    CommandBuffer _slice;
-
-    template <typename CommandT>
-    bool OnGlobalCommand(Command *typedCommand, GlobalMessages message)
+protected:
+    /** Loads a complete command from a (framed) buffer, without the EOM terminator.
+     *  \param data holds the NodeId, DeviceId, MessageId and the parameters.
+     *  \param length is the number of bytes in data.
+     *  \return Returns false if the length is invalid. The parser is Complete otherwise.
+     */
+    bool Load(const uint8_t *data, uint8_t length)
     {
-        if (_command.IsGlobalMessage(message) &&
-            CommandT::IsValidMessage(message))
-        {
-            CommandHandlerT::OnCommand(static_cast<CommandT *>(typedCommand));
-            return true;
-        }
-        return false;
-    }
+        Clear();
+        if (length < 3 || length - 3 > _params.getCapacity())
+            return false;
 
-    template <typename CommandT>
-    bool OnNodeCommand(Command *typedCommand, NodeMessages message)
-    {
-        if (_command.IsNodeMessage(message) &&
-            CommandT::IsValidMessage(message))
+        _command.NodeId = data[0];
+        _command.DeviceId = data[1];
+        _command.MessageId = data[2];
+        for (uint8_t i = 3; i < length; i++)
         {
-            CommandHandlerT::OnCommand(static_cast<CommandT *>(typedCommand));
-            return true;
+            _params.Add(data[i]);
         }
-        return false;
-    }
 
-    template <typename CommandT>
-    bool OnDeviceCommand(Command *typedCommand, DeviceMessages message)
-    {
-        if (_command.IsDeviceMessage(message) &&
-            CommandT::IsValidMessage(message))
-        {
-            CommandHandlerT::OnCommand(static_cast<CommandT *>(typedCommand));
-            return true;
-        }
-        return false;
+        _state = ParserState::Complete;
+        return true;
     }
+
+private:
+    typedef CommandDispatchTable<CommandParser, GlobalCommands> GlobalDispatchTable;
+    typedef CommandDispatchTable<CommandParser, NodeCommands> NodeDispatchTable;
+    // calls the (protected) OnCommand of the handler
+    template <class, class, bool>
+    friend struct CommandDispatcher;
+
+    ParserState _state = ParserState::Idle;
+    ParserError _error = ParserError::NoError;
+    Command _command;
+    Collection<FixedArray<uint8_t, 8>> _params;
 };
\ No newline at end of file
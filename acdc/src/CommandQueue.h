@@ -0,0 +1,75 @@
+#pragma once
+#include <stdint.h>
+#include "../lib/atl/RingBuffer.h"
+
+/** The CommandQueue runs the parser from the receive interrupt and queues the decoded commands,
+ *  so a command is complete as soon as its last byte arrives (not when the main loop gets to it)
+ *  and the raw receive buffer only has to cover a single interrupt.
+ *  `Parse()` is called from `ISR(USARTn_RX_vect)`; the main loop calls `TryRead()` and
+ *  dispatches the record with `ParserT::Dispatch(const Record &)`.
+ *  Parse errors are queued as a record (so the main loop can report them);
+ *  a full queue drops the command and counts it.
+ *  \tparam ParserT is the command parser. It implements
+ *  `bool Parse(char)`, `bool IsError() const`, `bool IsComplete() const`, `void Clear()`,
+ *  `Record getRecord() const` and the `Record` type.
+ *  \tparam QueueSize is the number of decoded commands that can be queued (a power of two).
+ */
+template <class ParserT, const uint8_t QueueSize = 4>
+class CommandQueue
+{
+public:
+    typedef typename ParserT::Record RecordT;
+
+    /** Constructs the instance.
+     *  \param parser is the parser that is run from the interrupt.
+     */
+    CommandQueue(ParserT *parser)
+        : _parser(parser)
+    {
+    }
+
+    /** Call this method from the `ISR(USARTn_RX_vect)` interrupt handler for each received byte.
+     *  Not meant to be called from regular code.
+     *  \param data is the received byte.
+     *  \return Returns true when a record was queued.
+     */
+    bool Parse(uint8_t data)
+    {
+        _parser->Parse(data);
+        if (!_parser->IsError() && !_parser->IsComplete())
+            return false;
+
+        bool queued = _queue.Write(_parser->getRecord());
+        if (!queued && _droppedCount < 0xFF)
+            _droppedCount++;
+
+        _parser->Clear();
+        return queued;
+    }
+
+    /** Takes the next decoded command (main loop).
+     *  \param outRecord receives the command.
+     *  \return Returns false if the queue is empty.
+     */
+    bool TryRead(RecordT *outRecord)
+    {
+        return _queue.TryRead(outRecord);
+    }
+
+    bool getIsEmpty() const
+    {
+        return _queue.getIsEmpty();
+    }
+
+    /** Returns the number of commands dropped because the queue was full.
+     */
+    uint8_t getDroppedCount() const
+    {
+        return _droppedCount;
+    }
+
+private:
+    ParserT *_parser;
+    RingBufferSpsc<RecordT, QueueSize> _queue;
+    volatile uint8_t _droppedCount = 0;
+};
@@ -6,6 +6,11 @@
 
 typedef Slice<uint8_t> CommandBuffer;
 
+// the ParameterLength of a command with a variable length (it implements TryDeserialize)
+const uint8_t VariableParameterLength = 0xFF;
+// the number of blocks on this node (BlockId 1-4): a command for another block is rejected
+const uint8_t NodeBlockCount = 4;
+
 enum class GlobalMessages : uint8_t
 {
     None = 0x00,
@@ -20,10 +25,15 @@ enum class NodeMessages : uint8_t
     None = 0x00,
     Reset = 0x01,     // resets the node and all its devices
     Heartbeat = 0x02, // sent by node to let it know it is still alive. (interval?)
+    Poll = 0x03,      // sent by the bus master: the node answers in its slot (NodeBus)
 
     BlockPower = 0x40,      // turns power on/off for a specified block
     BlockSpeed = 0x41,      // sets speed for a specified block
     BlockOccupation = 0x42, // event
+    TrainAssign = 0x43,     // places a train with its direction and speed in a specified block
+    TrainSpeed = 0x44,      // sets the speed for a specified train
+    BlockSpeedBatch = 0x45, // sets the speeds for the blocks in a mask (packed speeds)
+    BlockPowerMask = 0x46,  // turns power on/off for the blocks in a mask
 
     Invalid = 0xFF
 };
@@ -89,6 +99,12 @@ struct Command
         MessageId = command.MessageId;
     }
 
+    // called after Deserialize: a command that is not valid is rejected (not passed to the handler)
+    bool IsValid() const
+    {
+        return true;
+    }
+
 protected:
     uint8_t Serialize(CommandBuffer &buffer)
     {
@@ -108,88 +124,43 @@ private:
 };
 
 //-----------------------------------------------------------------------------
-struct GlobalResetCommand;
+// The commands are decoded with a dispatch table (see CommandDispatchTable in CommandBuilder.h).
+// A decoded command declares its Message, its ParameterLength and implements Deserialize
+// (or TryDeserialize when the ParameterLength is VariableParameterLength).
+// A command with a fixed ParameterLength can check its parameters in IsValid.
 
 struct GlobalCommand : Command
 {
-    static bool TryCreate(Command &command, CommandBuffer &data, GlobalCommand **outCommand)
-    {
-        if (TryCreate<GlobalResetCommand>(command, data, outCommand))
-            return true;
-
-        *outCommand = nullptr;
-        return false;
-    }
-
 protected:
     GlobalCommand() {}
-
-private:
-    template <typename GlobalCommandT>
-    static bool TryCreate(Command command, CommandBuffer &data, GlobalCommand **outCommand)
-    {
-        return GlobalCommandT::TryCreate(command, data, (GlobalCommandT **)outCommand);
-    }
 };
 
 struct GlobalResetCommand : GlobalCommand
 {
-    static bool TryCreate(Command &command, CommandBuffer &data, GlobalResetCommand **outCommand)
-    {
-        if (command.IsGlobalMessage(GlobalMessages::Reset))
-        {
-            _instance.Take(command);
-            *outCommand = &_instance;
-            return true;
-        }
+    static const GlobalMessages Message = GlobalMessages::Reset;
+    static const uint8_t ParameterLength = 0;
 
-        *outCommand = nullptr;
-        return false;
-    }
-
-    static bool IsValidMessage(GlobalMessages message)
+    void Deserialize(const uint8_t * /*data*/)
     {
-        return message == GlobalMessages::Reset;
     }
-
-private:
-    static GlobalResetCommand _instance;
 };
 
-GlobalResetCommand GlobalResetCommand::_instance;
-
 //-----------------------------------------------------------------------------
-struct BlockPowerCommand;
-struct BlockSpeedCommand;
-
 struct NodeCommand : Command
 {
-    static bool TryCreate(Command &command, CommandBuffer &data, NodeCommand **outCommand)
-    {
-        if (TryCreate<BlockPowerCommand>(command, data, outCommand))
-            return true;
-        if (TryCreate<BlockSpeedCommand>(command, data, outCommand))
-            return true;
-
-        *outCommand = nullptr;
-        return false;
-    }
-
 protected:
     NodeCommand() {}
-
-private:
-    template <typename NodeCommandT>
-    static bool TryCreate(Command command, CommandBuffer &data, NodeCommand **outCommand)
-    {
-        return NodeCommandT::TryCreate(command, data, (NodeCommandT **)outCommand);
-    }
 };
 
 struct BlockNodeCommand : NodeCommand
 {
     uint8_t BlockId;
 
+    bool IsValid() const
+    {
+        return BlockId >= 1 && BlockId <= NodeBlockCount;
+    }
+
 protected:
     uint8_t Serialize(CommandBuffer &buffer)
     {
@@ -201,64 +172,123 @@ protected:
 
 struct BlockPowerCommand : BlockNodeCommand
 {
+    static const NodeMessages Message = NodeMessages::BlockPower;
+    static const uint8_t ParameterLength = 2;
+
     bool PowerOn;
 
-    static bool TryCreate(Command command, CommandBuffer &data, BlockPowerCommand **outCommand)
+    void Deserialize(const uint8_t *data)
     {
-        if (command.IsNodeMessage(NodeMessages::BlockPower))
-        {
-            _instance.Take(command);
-            _instance.BlockId = data[0];
-            _instance.PowerOn = data[1] > 0;
-            *outCommand = &_instance;
-            return true;
-        }
-
-        *outCommand = nullptr;
-        return false;
+        BlockId = data[0];
+        PowerOn = data[1] > 0;
     }
+};
 
-    static bool IsValidMessage(NodeMessages message)
+struct BlockSpeedCommand : BlockNodeCommand
+{
+    static const NodeMessages Message = NodeMessages::BlockSpeed;
+    static const uint8_t ParameterLength = 2;
+
+    uint8_t Speed;
+
+    void Deserialize(const uint8_t *data)
     {
-        return message == NodeMessages::BlockPower;
+        BlockId = data[0];
+        Speed = data[1];
     }
-
-private:
-    static BlockPowerCommand _instance;
 };
 
-BlockPowerCommand BlockPowerCommand::_instance;
+struct TrainAssignCommand : BlockNodeCommand
+{
+    static const NodeMessages Message = NodeMessages::TrainAssign;
+    static const uint8_t ParameterLength = 4;
 
-struct BlockSpeedCommand : BlockNodeCommand
+    uint8_t TrainId;
+    bool Forward;
+    uint8_t Speed;
+
+    void Deserialize(const uint8_t *data)
+    {
+        BlockId = data[0];
+        TrainId = data[1];
+        Forward = data[2] > 0;
+        Speed = data[3];
+    }
+};
+
+struct TrainSpeedCommand : NodeCommand
 {
+    static const NodeMessages Message = NodeMessages::TrainSpeed;
+    static const uint8_t ParameterLength = 2;
+
+    uint8_t TrainId;
     uint8_t Speed;
 
-    static bool TryCreate(Command command, CommandBuffer &data, BlockSpeedCommand **outCommand)
+    void Deserialize(const uint8_t *data)
+    {
+        TrainId = data[0];
+        Speed = data[1];
+    }
+};
+
+// Block masks: bit 0 is BlockId 1, bit 1 is BlockId 2 etc.
+// The batch commands change all blocks in one go (and in one PCA9685 transaction).
+
+struct BlockSpeedBatchCommand : NodeCommand
+{
+    static const NodeMessages Message = NodeMessages::BlockSpeedBatch;
+    static const uint8_t ParameterLength = VariableParameterLength;
+    // a command has at most 8 parameter bytes: the mask and 7 speeds
+    static const uint8_t MaxBlocks = 7;
+    static_assert(NodeBlockCount <= MaxBlocks, "The node has more blocks than a batch can hold.");
+
+    uint8_t BlockMask;
+    // indexed by block (bit in BlockMask), only valid for the blocks in the mask
+    uint8_t Speeds[MaxBlocks];
+
+    // BlockMask followed by the speeds of the blocks in the mask, lowest block first
+    bool TryDeserialize(const uint8_t *data, uint8_t length)
     {
-        if (command.IsNodeMessage(NodeMessages::BlockSpeed))
+        // no bits for blocks the node does not have
+        if (length == 0 || (data[0] >> NodeBlockCount) != 0)
+            return false;
+
+        BlockMask = data[0];
+        uint8_t index = 1;
+        for (uint8_t block = 0; block < MaxBlocks; block++)
         {
-            _instance.Take(command);
-            _instance.BlockId = data[0];
-            _instance.Speed = data[1];
-            *outCommand = &_instance;
-            return true;
+            if ((BlockMask & (1 << block)) == 0)
+                continue;
+            if (index >= length)
+                return false;
+            Speeds[block] = data[index++];
         }
-
-        *outCommand = nullptr;
-        return false;
+        return index == length;
     }
+};
+
+struct BlockPowerMaskCommand : NodeCommand
+{
+    static const NodeMessages Message = NodeMessages::BlockPowerMask;
+    static const uint8_t ParameterLength = 2;
+
+    uint8_t BlockMask;
+    // the power for the blocks in the mask (same bit layout)
+    uint8_t PowerFlags;
 
-    static bool IsValidMessage(NodeMessages message)
+    void Deserialize(const uint8_t *data)
     {
-        return message == NodeMessages::BlockSpeed;
+        BlockMask = data[0];
+        PowerFlags = data[1];
     }
 
-private:
-    static BlockSpeedCommand _instance;
+    // no bits for blocks the node does not have
+    bool IsValid() const
+    {
+        return (BlockMask >> NodeBlockCount) == 0;
+    }
 };
 
-BlockSpeedCommand BlockSpeedCommand::_instance;
-
 struct BlockOccupationEvent : public NodeCommand
 {
     // max 8 flags
@@ -292,24 +322,8 @@ BlockOccupationEvent BlockOccupationEvent::_instance;
 
 struct DeviceCommand : Command
 {
-    static bool TryCreate(Command &command, CommandBuffer &data, NodeCommand **outCommand)
-    {
-        // if (TryCreate<ResetDeviceCommand>(command, data, outCommand))
-        //     return true;
-
-        *outCommand = nullptr;
-        return false;
-    }
-
 protected:
     DeviceCommand() {}
-
-private:
-    template <typename DeviceCommandT>
-    static bool TryCreate(Command command, CommandBuffer &data, NodeCommand **outCommand)
-    {
-        return DeviceCommandT::TryCreate(command, data, (DeviceCommandT **)outCommand);
-    }
 };
 
 //-----------------------------------------------------------------------------
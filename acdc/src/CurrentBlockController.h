@@ -47,21 +47,21 @@ public:
                 _lastShuntV = shunt;
 
                 serial.Transmit.Write(Math::Abs(_lastShuntV) > (int16_t)threshold ? "Y" : "N");
-                serial.Transmit.Write(" ");
+                serial.Transmit.Write(' ');
                 serial.Transmit.Write(CurrentSensorT::getAddress());
-                serial.Transmit.Write(" ");
+                serial.Transmit.Write(' ');
                 serial.Transmit.Write(_lastShuntV);
 
-                serial.Transmit.Write(" (");
+                serial.Transmit.Write(F(" ("));
                 serial.Transmit.Write(bus);
-                serial.Transmit.Write(") ");
+                serial.Transmit.Write(F(") "));
                 serial.Transmit.Write(shuntDelta);
 
                 serial.Transmit.WriteLine();
             }
         }
         else
-            serial.Transmit.Write(".");
+            serial.Transmit.Write('.');
 
         return Math::Abs(_lastShuntV) > (int16_t)threshold;
     }
@@ -1,130 +1,173 @@
 #pragma once
 #include <stdint.h>
-#include "../lib/atl/FixedArray.h"
+#include <avr/pgmspace.h>
 #include "../lib/atl/Debug.h"
+#include "../lib/atl/TextWriter.h"
 
-// -----------------------------------------------------------------------------
+/*
+    The DCC-EX text protocol (the subset that makes sense for DC blocks), so standard throttles
+    (JMRI, EX-WebThrottle) can drive the blocks. A command is '<' opcode [parameters] '>',
+    parameters are separated by spaces.
 
-template <class BufferT>
-class DccExCommandParser
+    <0> <0 MAIN>            power off           -> <p0> / <p0 MAIN>
+    <1> <1 MAIN>            power on            -> <p1> / <p1 MAIN>
+    <s>                     status              -> <p0|1> <iDCC-EX ...>
+    <t cab speed dir>       throttle            -> <l cab 0 speedByte 0>
+    <t reg cab speed dir>   (legacy form, reg is ignored)
+    <T id state>            turnout (0/C closed, 1/T thrown) -> <H id 0|1>
+    <Q>                     sensor states       -> <Q id> (active) or <q id> (inactive) per sensor
+    An invalid or unsupported command is answered with <X>.
+ */
+
+/** A keyword parameter (a word instead of a number). */
+enum class DccExKeyword : int16_t
+{
+    Unknown,
+    Main,
+    Prog,
+    Join,
+    Closed, // 'C'
+    Thrown, // 'T'
+};
+
+/** The DccExCommandParser parses the DCC-EX text commands character by character (no buffering of
+ *  text, no allocation): numbers are accumulated in place as signed 16-bit values, words are matched
+ *  against the DccExKeyword list. The opcode is looked up in a (PROGMEM) dispatch table that also
+ *  validates the number of parameters.
+ *  \tparam CommandHandlerT is used as base class and implements
+ *  `void OnPower(bool on)`, `bool getIsPowerOn()`,
+ *  `bool OnThrottle(uint16_t cab, int8_t speed, bool forward)` (speed -1 is an emergency stop, 0-126),
+ *  `bool OnTurnout(uint16_t id, bool thrown)` and
+ *  `bool TryGetSensor(uint8_t index, uint16_t *outId, bool *outActive)` (false after the last sensor).
+ */
+template <class CommandHandlerT>
+class DccExCommandParser : public CommandHandlerT
 {
 public:
+    static const uint8_t DebugComponentId = 1;
+    static const uint8_t MaxParameters = 4;
+    /** Text commands: the EmergencyStop reserved byte ('!', the DCC-EX emergency stop) is taken out first. */
+    static const bool IsTextProtocol = true;
+
     enum class CommandType : uint8_t
     {
         None,
-        Power,
-        Status,
-        TrackMode
+        PowerOff, // <0>
+        PowerOn,  // <1>
+        Status,   // <s>
+        Throttle, // <t>
+        Turnout,  // <T>
+        Sensors,  // <Q>
     };
 
     enum class ParserState : uint8_t
     {
         Idle,
-        Command,
-        Parameter,
+        Opcode,
+        Separator,
+        Number,
+        Word,
         Complete,
         Error
     };
 
+    enum class ParserError : uint8_t
+    {
+        NoError,
+        InvalidCommand,
+        InvalidParameter
+    };
+
     DccExCommandParser()
     {
         Clear();
     }
 
-    template <class DispatcherT>
-    bool Dispatch(DispatcherT &dispatcher)
+    /** Parses the next character.
+     *  \param data is the received character.
+     *  \return Returns true at the closing '>': the command is complete or an error (call `Dispatch()`).
+     */
+    bool Parse(char data)
     {
-        if (IsComplete())
+        // always (re)starts a command: a lost '>' does not stall the stream
+        if (data == '<')
         {
-            return dispatcher.Dispatch(_command, _params.getBuffer(), _paramIndex);
+            Clear();
+            _state = ParserState::Opcode;
+            return false;
         }
-        return false;
-    }
 
-    bool Parse(char data)
-    {
         switch (_state)
         {
-        case ParserState::Complete:
-        case ParserState::Error:
-        case ParserState::Idle:
-            if (data == '<')
-            {
-                Clear();
-                Trace("State: Idle->Command");
-                _state = ParserState::Command;
-                return true;
-            }
-            if (data == '>')
-            {
-                Trace("State: Idle->Error[InvalidCommand]");
-                _error = ParserError::InvalidCommand;
-                return true;
-            }
-            break;
-        case ParserState::Command:
+        case ParserState::Opcode:
+            if (IsSpace(data))
+                return false;
+            if (!TryLookup(data))
+                return Fail(ParserError::InvalidCommand, data);
+            _state = ParserState::Separator;
+            return false;
+
+        case ParserState::Separator:
             if (data == '>')
+                return Complete();
+            if (IsSpace(data))
+                return false;
+            // the start of the next parameter
+            if (_count >= MaxParameters)
+                return Fail(ParserError::InvalidParameter, data);
+            _negative = data == '-';
+            _value = 0;
+            _word = 0;
+            _length = 0;
+            if (_negative)
             {
-                if (ParseCommand())
-                {
-                    Trace("State: Command->Complete");
-                    _state = ParserState::Complete;
-                }
-                else
-                {
-                    Trace("State: Command->Error[InvalidCommand]");
-                    _error = ParserError::InvalidCommand;
-                    _state = ParserState::Error;
-                }
-                return true;
-            }
-            else if (data == ' ')
-            {
-                if (ParseCommand())
-                {
-                    Trace("State: Command->Parameter");
-                    _state = ParserState::Parameter;
-                }
-                else
-                {
-                    Trace("State: Command->Error[InvalidCommand]");
-                    _error = ParserError::InvalidCommand;
-                    _state = ParserState::Error;
-                }
-                return true;
+                _state = ParserState::Number;
+                return false;
             }
-            else
+            return Accumulate(data);
+
+        case ParserState::Number:
+        case ParserState::Word:
+            if (data == '>' || IsSpace(data))
             {
-                _buffer.Write(data);
-                return true;
+                if (!TryEndParameter())
+                    return Fail(ParserError::InvalidParameter, data);
+                if (data == '>')
+                    return Complete();
+                _state = ParserState::Separator;
+                return false;
             }
-            break;
-        case ParserState::Parameter:
+            return Accumulate(data);
+
+        case ParserState::Error:
+            // wait for the end of the command before reporting the error
             if (data == '>')
             {
-                Trace("State: Parameter->Complete");
-                _state = ParserState::Complete;
+                _ended = true;
                 return true;
             }
-            else if (data == ' ')
-            {
-                if (!ParseParameter())
-                {
-                    Trace("State: Parameter->Error[InvalidParameter]");
-                    _error = ParserError::InvalidParameter;
-                    _state = ParserState::Error;
-                }
-                return true;
-            }
-            else
-            {
-                _buffer.Write(data);
-                return true;
-            }
-            break;
+            return false;
+
+        default:
+            return false;
         }
+    }
 
-        return false;
+    /** Dispatches the complete command to the handler and writes the reply (<X> on an error).
+     *  \tparam WriterT is a TextWriter.
+     *  \param writer receives the reply.
+     *  \return Returns false if the command was not valid or not executed.
+     */
+    template <class WriterT>
+    bool Dispatch(WriterT &writer)
+    {
+        if (_state != ParserState::Complete || !Execute(writer))
+        {
+            writer.Write(F("<X>"));
+            writer.WriteLine();
+            return false;
+        }
+        return true;
     }
 
     void Clear()
@@ -132,13 +175,14 @@ public:
         _state = ParserState::Idle;
         _command = CommandType::None;
         _error = ParserError::NoError;
-        _paramIndex = 0;
-        _params.Clear();
+        _ended = false;
+        _count = 0;
+        _keywords = 0;
     }
 
     bool IsError() const
     {
-        return _state == ParserState::Error;
+        return _state == ParserState::Error && _ended;
     }
 
     ParserError getError() const
@@ -151,69 +195,315 @@ public:
         return _state == ParserState::Complete;
     }
 
+    CommandType getCommand() const
+    {
+        return _command;
+    }
+
+    uint8_t getParameterCount() const
+    {
+        return _count;
+    }
+
+    /** Returns the parameter as a number (or a DccExKeyword, see `getIsKeyword()`).
+     */
+    int16_t getParameter(uint8_t index) const
+    {
+        return index < _count ? _params[index] : 0;
+    }
+
+    bool getIsKeyword(uint8_t index) const
+    {
+        return index < _count && (_keywords & (1 << index)) != 0;
+    }
+
 private:
-    BufferT _buffer;
+    struct DispatchEntry
+    {
+        char Opcode;
+        CommandType Command;
+        uint8_t MinParameters;
+        uint8_t MaxParameters;
+    };
+
+    static const uint8_t DispatchCount = 6;
+    static const DispatchEntry DispatchTable[DispatchCount];
+
     ParserState _state = ParserState::Idle;
     CommandType _command = CommandType::None;
     ParserError _error = ParserError::NoError;
-    uint8_t _paramIndex = 0;
-    FixedArray<uint8_t, 8> _params;
+    bool _ended = false;
+    bool _negative = false;
+    uint8_t _minParams = 0;
+    uint8_t _maxParams = 0;
+    uint8_t _count = 0;
+    // bit n set: parameter n is a DccExKeyword
+    uint8_t _keywords = 0;
+    int16_t _value = 0;
+    // the characters in the current parameter
+    uint8_t _length = 0;
+    // the first 4 characters of a word, packed
+    uint32_t _word = 0;
+    int16_t _params[MaxParameters];
 
-    /**
-     * @brief Parse the command from the buffer.
-     * /return Returns true if the command is valid.
-     */
-    bool ParseCommand()
+    static bool IsSpace(char data)
+    {
+        return data == ' ' || data == '\t' || data == '\r' || data == '\n';
+    }
+
+    static constexpr uint32_t Pack(char c0, char c1 = 0, char c2 = 0, char c3 = 0)
     {
-        char data;
-        if (_buffer.TryRead(&data))
+        return ((uint32_t)(uint8_t)c0 << 24) | ((uint32_t)(uint8_t)c1 << 16) |
+               ((uint32_t)(uint8_t)c2 << 8) | (uint8_t)c3;
+    }
+
+    void Count()
+    {
+        if (_length < 0xFF)
+            _length++;
+    }
+
+    bool TryLookup(char opcode)
+    {
+        for (uint8_t i = 0; i < DispatchCount; i++)
         {
-            switch (data)
+            if ((char)pgm_read_byte(&DispatchTable[i].Opcode) == opcode)
             {
-            case '0':
-            case '1':
-                _command = CommandType::Power;
-                _params[_paramIndex++] = data - '0';
-                return true;
-            case '=':
-                _command = CommandType::TrackMode;
+                _command = static_cast<CommandType>(pgm_read_byte(&DispatchTable[i].Command));
+                _minParams = pgm_read_byte(&DispatchTable[i].MinParameters);
+                _maxParams = pgm_read_byte(&DispatchTable[i].MaxParameters);
                 return true;
-            case 's':
-                _command = CommandType::Status;
-                return true;
-            default:
-                // TODO: continue reading multi char commands
-                return false;
             }
         }
         return false;
     }
 
-    bool ParseParameter()
+    bool Accumulate(char data)
     {
-#define PARAM_LEN 8
-        char data[PARAM_LEN];
-        uint16_t count = _buffer.Read(data, PARAM_LEN);
+        if (data >= '0' && data <= '9' && _state != ParserState::Word)
+        {
+            int16_t digit = data - '0';
+            // accumulated negative: -32768 fits
+            if (_value < (-32768 + digit) / 10)
+                return Fail(ParserError::InvalidParameter, data);
+            _value = _value * 10 - digit;
+            Count();
+            _state = ParserState::Number;
+            return false;
+        }
+
+        bool letter = (data >= 'A' && data <= 'Z') || (data >= 'a' && data <= 'z');
+        if (!letter || (_state == ParserState::Number))
+            return Fail(ParserError::InvalidParameter, data);
 
-        if (count > 0)
+        // upper case; a longer word than 'MAIN', 'PROG' or 'JOIN' is unknown
+        if (data >= 'a')
+            data -= 'a' - 'A';
+        if (_length < 4)
+            _word |= (uint32_t)(uint8_t)data << (24 - 8 * _length);
+        else
+            _word = 0xFFFFFFFF;
+        Count();
+        _state = ParserState::Word;
+        return false;
+    }
+
+    bool TryEndParameter()
+    {
+        if (_state == ParserState::Word)
         {
-            if (count == 1)
-            {
-                _params[_paramIndex++] = data[0];
-            }
-            else
-            {
-                // TODO: parse multi char parameters
-                _params[_paramIndex++] = data[0];
-            }
+            _params[_count] = static_cast<int16_t>(ToKeyword(_word));
+            _keywords |= 1 << _count;
+        }
+        // a lone '-' is no number
+        else if (_length == 0)
+            return false;
+        else if (_negative)
+            _params[_count] = _value;
+        // 32768 does not fit
+        else if (_value == -32768)
+            return false;
+        else
+            _params[_count] = -_value;
+
+        _count++;
+        return true;
+    }
+
+    static DccExKeyword ToKeyword(uint32_t word)
+    {
+        switch (word)
+        {
+        case Pack('M', 'A', 'I', 'N'):
+            return DccExKeyword::Main;
+        case Pack('P', 'R', 'O', 'G'):
+            return DccExKeyword::Prog;
+        case Pack('J', 'O', 'I', 'N'):
+            return DccExKeyword::Join;
+        case Pack('C'):
+            return DccExKeyword::Closed;
+        case Pack('T'):
+            return DccExKeyword::Thrown;
+        default:
+            return DccExKeyword::Unknown;
+        }
+    }
+
+    bool Complete()
+    {
+        if (_state == ParserState::Error)
             return true;
+        if (_count < _minParams || _count > _maxParams)
+            return Fail(ParserError::InvalidParameter, '>');
+
+        _state = ParserState::Complete;
+        return true;
+    }
+
+    bool Fail(ParserError error, char data)
+    {
+        Trace(DebugLog_Id("Error {} at char {}"), static_cast<int16_t>(error), data);
+        _error = error;
+        _state = ParserState::Error;
+        _ended = data == '>';
+        return _ended;
+    }
+
+    template <class WriterT>
+    bool Execute(WriterT &writer)
+    {
+        switch (_command)
+        {
+        case CommandType::PowerOff:
+        case CommandType::PowerOn:
+            return ExecutePower(writer, _command == CommandType::PowerOn);
+        case CommandType::Status:
+            WritePower(writer, false);
+            writer.Write(F("<iDCC-EX V-5.0.0 / ACDC / DC>"));
+            writer.WriteLine();
+            return true;
+        case CommandType::Throttle:
+            return ExecuteThrottle(writer);
+        case CommandType::Turnout:
+            return ExecuteTurnout(writer);
+        case CommandType::Sensors:
+            WriteSensors(writer);
+            return true;
+        default:
+            return false;
         }
+    }
 
-        return false;
+    template <class WriterT>
+    bool ExecutePower(WriterT &writer, bool on)
+    {
+        // DC blocks: there is only a main track
+        bool main = _count == 1;
+        if (main && (!getIsKeyword(0) || _params[0] != static_cast<int16_t>(DccExKeyword::Main)))
+            return false;
+
+        CommandHandlerT::OnPower(on);
+        WritePower(writer, main);
+        return true;
     }
 
-    void Trace(const char *message)
+    template <class WriterT>
+    void WritePower(WriterT &writer, bool main)
     {
-        Debug<1>::Log<DebugLevel::Trace>(message);
+        writer.Write(F("<p"));
+        writer.Write(CommandHandlerT::getIsPowerOn() ? '1' : '0');
+        if (main)
+            writer.Write(F(" MAIN"));
+        writer.Write('>');
+        writer.WriteLine();
     }
+
+    template <class WriterT>
+    bool ExecuteThrottle(WriterT &writer)
+    {
+        // <t cab speed dir> or the legacy <t reg cab speed dir>
+        uint8_t first = _count - 3;
+        if (_keywords != 0)
+            return false;
+
+        int16_t cab = _params[first];
+        int16_t speed = _params[first + 1];
+        int16_t dir = _params[first + 2];
+        if (cab <= 0 || speed < -1 || speed > 126 || dir < 0 || dir > 1)
+            return false;
+
+        if (!CommandHandlerT::OnThrottle((uint16_t)cab, (int8_t)speed, dir == 1))
+            return false;
+
+        // speed byte: 0 stop, 1 emergency stop, 2-127 speed 1-126; bit 7 is forward
+        uint8_t speedByte = (speed < 0 ? 1 : speed == 0 ? 0 : (uint8_t)(speed + 1)) | (dir == 1 ? 0x80 : 0);
+        writer.Write(F("<l "));
+        writer.Write((uint16_t)cab);
+        writer.Write(F(" 0 "));
+        writer.Write(speedByte);
+        writer.Write(F(" 0>"));
+        writer.WriteLine();
+        return true;
+    }
+
+    template <class WriterT>
+    bool ExecuteTurnout(WriterT &writer)
+    {
+        if (getIsKeyword(0) || _params[0] < 0)
+            return false;
+
+        bool thrown;
+        if (getIsKeyword(1))
+        {
+            if (_params[1] == static_cast<int16_t>(DccExKeyword::Thrown))
+                thrown = true;
+            else if (_params[1] == static_cast<int16_t>(DccExKeyword::Closed))
+                thrown = false;
+            else
+                return false;
+        }
+        else if (_params[1] == 0 || _params[1] == 1)
+            thrown = _params[1] == 1;
+        else
+            return false;
+
+        if (!CommandHandlerT::OnTurnout((uint16_t)_params[0], thrown))
+            return false;
+
+        writer.Write(F("<H "));
+        writer.Write((uint16_t)_params[0]);
+        writer.Write(thrown ? F(" 1>") : F(" 0>"));
+        writer.WriteLine();
+        return true;
+    }
+
+    template <class WriterT>
+    void WriteSensors(WriterT &writer)
+    {
+        uint16_t id;
+        bool active;
+        for (uint8_t i = 0; CommandHandlerT::TryGetSensor(i, &id, &active); i++)
+        {
+            writer.Write(active ? F("<Q ") : F("<q "));
+            writer.Write(id);
+            writer.Write('>');
+            writer.WriteLine();
+        }
+    }
+
+    static void Trace(uint16_t messageId, int16_t arg0 = 0, int16_t arg1 = 0)
+    {
+        LogTrace<DebugComponentId>(messageId, arg0, arg1);
+    }
+};
+
+template <class CommandHandlerT>
+const typename DccExCommandParser<CommandHandlerT>::DispatchEntry
+    DccExCommandParser<CommandHandlerT>::DispatchTable[DccExCommandParser<CommandHandlerT>::DispatchCount] PROGMEM = {
+        {'0', CommandType::PowerOff, 0, 1},
+        {'1', CommandType::PowerOn, 0, 1},
+        {'s', CommandType::Status, 0, 0},
+        {'t', CommandType::Throttle, 3, 4},
+        {'T', CommandType::Turnout, 2, 2},
+        {'Q', CommandType::Sensors, 0, 0},
 };
@@ -0,0 +1,195 @@
+#pragma once
+#include <stdint.h>
+#include <avr/io.h>
+#include "../lib/Port.h"
+#include "../lib/atl/LockScope.h"
+
+/** The EmergencyStop cuts the power to all blocks directly from an interrupt.
+ *  It drives the PCA9685 /OE line (or TB6612 STBY line) so all outputs are disabled without
+ *  going through the main loop, the command parser or any I2C transaction.
+ *  The stop is latched: the outputs stay disabled until `Release()` is called
+ *  and the main loop is notified through `TryTakeTriggered()`.
+ *
+ *  There are two triggers:
+ *  - the reserved byte `ReservedByte` received on the serial port (handled in `ISR(USART_RX_vect)`).
+ *    The byte is never passed on to the command parsers. Only with a text protocol: every byte value
+ *    is legal in a binary (COBS) frame, so there the e-stop is the input pin or a power off command.
+ *  - a (push button) input pin that is pulled low (handled in `ISR(PCINTn_vect)`).
+ *
+ *  Latency (16MHz):
+ *  - serial: the byte is available after its stop bit: 10 bits at 1Mbaud = 10us.
+ *  - input pin: 2 cycles synchronization.
+ *  - then the interrupt response and the ISR prologue (~4 + ~20 cycles, estimated from the generated code)
+ *    and the ISR body up to the output write. The body is measured (PROFILE: Timer1 runs at clock/8):
+ *    call `MarkInterrupt()` first thing in the ISR, `Trigger()` stores the cycles up to the output write
+ *    and `getLatencyCycles()` returns them (printed by the 'R' command).
+ *  The previous path (parser -> Dispatch -> OnPower(false)) waited for the main loop (up to 50ms)
+ *  and then took 4 PCA9685 I2C transactions of ~0.5ms each.
+ *
+ *  EmergencyStop is a static class and cannot be instantiated.
+ *  \tparam OutputPinId is the pin connected to PCA9685 /OE (or the TB6612 STBY).
+ *  \tparam StopLevel is the level the OutputPinId is driven to on a stop: true for /OE, false for STBY.
+ *  \tparam InputPinId is the (active low) input pin that triggers the stop.
+ *  The input pin must be on port B, C or D (ATmega328P) or on port B or K (ATmega2560).
+ *  Implement the matching `ISR(PCINTn_vect)` and call `OnInputChanged()`.
+ */
+template <const PortPins OutputPinId, const bool StopLevel, const PortPins InputPinId>
+class EmergencyStop
+{
+#ifdef PORTK
+    // ATmega2560: port B = PCINT0-7 (PCMSK0), port K = PCINT16-23 (PCMSK2).
+    // PCMSK1 mixes PE0 and PJ0-6: not supported.
+    static_assert(TO_PORT(InputPinId) == Ports::B || TO_PORT(InputPinId) == Ports::K,
+                  "The InputPinId must be on port B or K.");
+    static const uint8_t PinChangeGroup = TO_PORT(InputPinId) == Ports::K ? 2 : 0;
+#else
+    // ATmega328P: port B = PCINT0-7 (PCMSK0), port C = PCINT8-14 (PCMSK1), port D = PCINT16-23 (PCMSK2)
+    static_assert(TO_PORT(InputPinId) >= Ports::B && TO_PORT(InputPinId) <= Ports::D,
+                  "The InputPinId must be on port B, C or D.");
+    static const uint8_t PinChangeGroup = ((uint8_t)TO_PORT(InputPinId) >> 3) - 2;
+#endif
+
+public:
+    /** The byte on the serial port that triggers an emergency stop. */
+    static const uint8_t ReservedByte = '!';
+
+    /** Indicates what triggered the emergency stop.
+     */
+    enum class Source : uint8_t
+    {
+        None,
+        Serial,
+        Input,
+        Watchdog, // TaskWatchdog safe stop before a reset
+    };
+
+    /** Configures the output and the input pin and its pin change interrupt.
+     *  \param source is None to enable the outputs. Any other source opens with the stop latched
+     *  (and not yet reported), for instance after a watchdog reset: the PCA9685 keeps its duty cycles
+     *  across an MCU reset, so the outputs must stay off until `Release()`.
+     */
+    static void Open(Source source = Source::None)
+    {
+        _source = source;
+        _reported = source == Source::None;
+
+        PortPin<OutputPinId>::Write(source == Source::None ? !StopLevel : StopLevel);
+        PortPin<OutputPinId>::SetDirection(Output);
+
+        PortPin<InputPinId>::SetDirection(Input);
+        PortPin<InputPinId>::EnablePullup(true);
+        EnablePinChangeInterrupt();
+    }
+
+    /** Disables the outputs immediately and latches the stop.
+     *  Can be called from an interrupt.
+     *  \param source indicates what triggered the stop.
+     */
+    static void Trigger(Source source)
+    {
+        PortPin<OutputPinId>::Write(StopLevel);
+#ifdef PROFILE
+        _latencyCycles = (uint16_t)(TCNT1 - _interruptAt) * CyclesPerTimer1Tick;
+#endif
+
+        if (_source == Source::None)
+        {
+            _source = source;
+            _reported = false;
+        }
+    }
+
+#ifdef PROFILE
+    /** Call this method first thing in the ISR that can trigger the stop.
+     *  The latency of the next `Trigger()` is measured from here.
+     */
+    static void MarkInterrupt()
+    {
+        _interruptAt = TCNT1;
+    }
+
+    /** Returns the cycles from `MarkInterrupt()` to the output write of the last `Trigger()`.
+     */
+    static uint16_t getLatencyCycles()
+    {
+        return _latencyCycles;
+    }
+#endif
+
+    /** Call this method from the `ISR(PCINTn_vect)` interrupt handler for the InputPinId.
+     *  Not meant to be called from regular code.
+     */
+    static void OnInputChanged()
+    {
+        if (!PortPin<InputPinId>::Read())
+            Trigger(Source::Input);
+    }
+
+    /** Retrieves (once) that an emergency stop has occurred.
+     *  Call from the main loop to report the stop.
+     *  \param outSource receives what triggered the stop.
+     *  \return Returns true the first time after a stop was triggered.
+     */
+    static bool TryTakeTriggered(Source *outSource)
+    {
+        if (_reported)
+            return false;
+
+        _reported = true;
+        *outSource = _source;
+        return true;
+    }
+
+    /** Enables the outputs again.
+     *  \return Returns false if the input pin is still active; the stop remains.
+     */
+    static bool Release()
+    {
+        // a Trigger() from an interrupt must not slip in between
+        LockScope lock;
+        if (!PortPin<InputPinId>::Read())
+            return false;
+
+        _source = Source::None;
+        PortPin<OutputPinId>::Write(!StopLevel);
+        return true;
+    }
+
+    static bool getIsStopped()
+    {
+        return _source != Source::None;
+    }
+
+private:
+    static volatile Source _source;
+    static volatile bool _reported;
+#ifdef PROFILE
+    // FreeRunningTimer1 prescaler
+    static const uint8_t CyclesPerTimer1Tick = 8;
+    static volatile uint16_t _interruptAt;
+    static volatile uint16_t _latencyCycles;
+#endif
+
+    static void EnablePinChangeInterrupt()
+    {
+        (&PCMSK0)[PinChangeGroup] |= 1 << (uint8_t)TO_PIN(InputPinId);
+        PCIFR = 1 << PinChangeGroup;
+        PCICR |= 1 << PinChangeGroup;
+    }
+
+    EmergencyStop() {}
+};
+
+template <const PortPins OutputPinId, const bool StopLevel, const PortPins InputPinId>
+volatile typename EmergencyStop<OutputPinId, StopLevel, InputPinId>::Source EmergencyStop<OutputPinId, StopLevel, InputPinId>::_source = EmergencyStop<OutputPinId, StopLevel, InputPinId>::Source::None;
+template <const PortPins OutputPinId, const bool StopLevel, const PortPins InputPinId>
+volatile bool EmergencyStop<OutputPinId, StopLevel, InputPinId>::_reported = true;
+#ifdef PROFILE
+template <const PortPins OutputPinId, const bool StopLevel, const PortPins InputPinId>
+volatile uint16_t EmergencyStop<OutputPinId, StopLevel, InputPinId>::_interruptAt = 0;
+template <const PortPins OutputPinId, const bool StopLevel, const PortPins InputPinId>
+volatile uint16_t EmergencyStop<OutputPinId, StopLevel, InputPinId>::_latencyCycles = 0;
+#endif
+
+// PCA9685 /OE on B2 (high = outputs off), e-stop button on B4 (PCINT4 -> ISR(PCINT0_vect))
+typedef EmergencyStop<PortPins::B2, true, PortPins::B4> EmergencyStopT;
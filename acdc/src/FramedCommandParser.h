@@ -0,0 +1,122 @@
+#pragma once
+#include <stdint.h>
+
+#include "../lib/atl/Cobs.h"
+#include "../lib/atl/Crc16.h"
+#include "CommandParser.h"
+
+// NodeId, DeviceId, MessageId, max 8 parameters and the CRC
+const uint8_t MaxCommandFrameLength = 3 + 8 + 2;
+
+/** A command frame is the serialized Command (without EOM) followed by its CRC-16 (MSB first),
+ *  COBS encoded and terminated by a 0x00 delimiter:
+ *  COBS(NodeId DeviceId MessageId [params] CRC-hi CRC-lo) 0x00
+ *  Parameter bytes can have any value (including 0xFF and 0x00).
+ *  CommandFrame is a static class and cannot be instantiated.
+ */
+class CommandFrame
+{
+public:
+    /** Writes the data as a command frame.
+     *  \tparam WriterT implements `void WriteData(uint8_t)`.
+     *  \param writer receives the frame bytes.
+     *  \param data is the serialized command (without EOM).
+     *  \param length is the number of bytes in data.
+     *  \return Returns false if the data is too long.
+     */
+    template <class WriterT>
+    static bool Write(WriterT &writer, const uint8_t *data, uint8_t length)
+    {
+        if (length > MaxCommandFrameLength - 2)
+            return false;
+
+        uint8_t frame[MaxCommandFrameLength];
+        for (uint8_t i = 0; i < length; i++)
+        {
+            frame[i] = data[i];
+        }
+
+        uint16_t crc = Crc16::Calculate(data, length);
+        frame[length] = crc >> 8;
+        frame[length + 1] = crc & 0xFF;
+
+        CobsEncoder::Write(writer, frame, length + 2);
+        return true;
+    }
+
+private:
+    CommandFrame() {}
+};
+
+/** The FramedCommandParser parses COBS/CRC-16 command frames (see CommandFrame) byte by byte
+ *  and dispatches them like the CommandParser.
+ *  A damaged frame (bad CRC, too long, bad COBS) is dropped and counted; parsing continues
+ *  with the next frame after the 0x00 delimiter, so noise never stalls the stream.
+ */
+template <class CommandHandlerT>
+class FramedCommandParser : public CommandParser<CommandHandlerT>
+{
+    typedef CommandParser<CommandHandlerT> BaseT;
+
+public:
+    /** Parses the next received byte.
+     *  \param data is the received byte.
+     *  \return Returns true when a valid frame is complete (`IsComplete()`).
+     */
+    bool Parse(uint8_t data)
+    {
+        switch (_decoder.Decode(data))
+        {
+        case CobsDecoder<MaxCommandFrameLength>::Result::Complete:
+            return Accept(_decoder.getData(), _decoder.getLength());
+        case CobsDecoder<MaxCommandFrameLength>::Result::Error:
+            _frameErrorCount++;
+            return false;
+        default:
+            return false;
+        }
+    }
+
+    /** Returns the number of frames dropped on framing (COBS, length) errors.
+     */
+    uint16_t getFrameErrorCount() const
+    {
+        return _frameErrorCount;
+    }
+
+    /** Returns the number of frames dropped on a CRC mismatch.
+     */
+    uint16_t getCrcErrorCount() const
+    {
+        return _crcErrorCount;
+    }
+
+private:
+    CobsDecoder<MaxCommandFrameLength> _decoder;
+    uint16_t _frameErrorCount = 0;
+    uint16_t _crcErrorCount = 0;
+
+    bool Accept(const uint8_t *frame, uint8_t length)
+    {
+        if (length < 2)
+        {
+            _frameErrorCount++;
+            return false;
+        }
+
+        length -= 2;
+        uint16_t crc = ((uint16_t)frame[length] << 8) | frame[length + 1];
+        if (Crc16::Calculate(frame, length) != crc)
+        {
+            _crcErrorCount++;
+            return false;
+        }
+
+        if (!BaseT::Load(frame, length))
+        {
+            _frameErrorCount++;
+            return false;
+        }
+        return true;
+    }
+};
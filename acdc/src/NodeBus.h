@@ -0,0 +1,343 @@
+#pragma once
+#include <stdint.h>
+#include "../lib/atl/RingBuffer.h"
+#include "Commands.h"
+
+/*
+    The NodeBus is a master polled protocol for many nodes on one (RS-485) line.
+    Only the master starts a transmission: it polls the nodes round robin and a node only answers
+    to its own poll, within its slot. So there are no collisions and the cycle time is bounded:
+    a cycle never takes longer than NodeCount * SlotLength and an event queued at a node is reported
+    within one cycle (two when the reply is lost).
+
+    Poll  (master -> node):   NodeId, NoneId, NodeMessages::Poll, ack-sequence
+    Reply (node -> master):   NodeId, sequence, [length, message]...
+    A message is a serialized command (without EOM), for instance a BlockOccupationEvent.
+    The node repeats its last reply until the master acknowledges its sequence in the next poll,
+    the master ignores a repeated sequence: events are not lost or reported twice.
+
+    Slot length: the poll frame + the node's response time + the reply frame. At 500k baud a frame
+    byte (9 data bits) takes 22us: a full 16 byte reply takes less than 0.5ms.
+ */
+
+/** The address of the bus master on the Rs485 transport. */
+const uint8_t BusMasterAddress = Command::NoneId;
+
+/** The BusMaster polls the nodes 1 to nodeCount and passes their messages to the handler.
+ *  A node that does not reply within the slot length has missed its poll;
+ *  after MaxMissedPolls in a row it is reported offline (and online again on its next reply).
+ *  Call `Run()` often (each ms or faster): it never waits.
+ *  \tparam TransportT is the Rs485 class. The master is opened with BusMasterAddress.
+ *  \tparam TimeT is the time source. Implements `uint32_t getTicks()`.
+ *  \tparam MaxNodes is the maximum number of nodes.
+ *  \tparam HandlerT is used as base class and implements
+ *  `void OnNodeMessage(uint8_t nodeId, const uint8_t *data, uint8_t length)` and
+ *  `void OnNodeOnline(uint8_t nodeId, bool online)`.
+ */
+template <class TransportT, class TimeT, const uint8_t MaxNodes, class HandlerT>
+class BusMaster : public HandlerT
+{
+public:
+    /** Misses in a row before a node is reported offline. */
+    static const uint8_t MaxMissedPolls = 3;
+
+    /** Constructs the instance.
+     *  \param transport is the opened Rs485 transport.
+     */
+    BusMaster(TransportT *transport)
+        : _transport(transport)
+    {
+    }
+
+    /** Starts polling.
+     *  \param nodeCount is the number of nodes (1 to nodeCount, max MaxNodes).
+     *  \param slotLength is the maximum time (ticks of TimeT) for a poll and its reply.
+     *  \return Returns false if the node count is invalid.
+     */
+    bool Open(uint8_t nodeCount, uint32_t slotLength)
+    {
+        if (nodeCount == 0 || nodeCount > MaxNodes)
+            return false;
+
+        _nodeCount = nodeCount;
+        _slotLength = slotLength;
+        _current = nodeCount - 1;
+        _waiting = false;
+        for (uint8_t i = 0; i < MaxNodes; i++)
+        {
+            _nodes[i] = NodeState();
+            _nodes[i].Sequence = NoSequence;
+        }
+        return true;
+    }
+
+    /** Returns the worst-case cycle time (ticks of TimeT): every node is polled within this time.
+     */
+    uint32_t getMaxCycleTime() const
+    {
+        return (uint32_t)_nodeCount * _slotLength;
+    }
+
+    bool getIsOnline(uint8_t nodeId) const
+    {
+        return IsValidNode(nodeId) && _nodes[nodeId - 1].Online;
+    }
+
+    /** Returns the number of polls the node did not answer (saturates at 0xFFFF).
+     */
+    uint16_t getMissedPolls(uint8_t nodeId) const
+    {
+        return IsValidNode(nodeId) ? _nodes[nodeId - 1].MissedTotal : 0;
+    }
+
+    /** Call this method repeatedly. Handles the reply or the end of the slot and sends the next poll.
+     */
+    void Run()
+    {
+        uint32_t now = TimeT::getTicks();
+
+        if (_waiting)
+        {
+            uint8_t length;
+            if (_transport->TryReadFrame(_frame, &length) && TryReply(length))
+                _waiting = false;
+            else if (now - _slotStart < _slotLength)
+                return;
+            else
+            {
+                OnMissed();
+                _waiting = false;
+            }
+        }
+
+        if (_transport->getIsSending())
+            return;
+
+        // a late reply of the previous node must not end up in the next slot
+        uint8_t stale;
+        _transport->TryReadFrame(_frame, &stale);
+
+        _current++;
+        if (_current >= _nodeCount)
+            _current = 0;
+
+        uint8_t nodeId = _current + 1;
+        _frame[0] = nodeId;
+        _frame[1] = Command::NoneId;
+        _frame[2] = static_cast<uint8_t>(NodeMessages::Poll);
+        _frame[3] = _nodes[_current].Sequence;
+        if (_transport->TryWriteFrame(nodeId, _frame, 4))
+        {
+            _slotStart = now;
+            _waiting = true;
+        }
+    }
+
+private:
+    static const uint8_t NoSequence = 0xFF;
+    static const uint8_t FrameSize = TransportT::MaxFrameLength;
+
+    struct NodeState
+    {
+        uint16_t MissedTotal;
+        uint8_t Missed;
+        uint8_t Sequence;
+        bool Online;
+    };
+
+    TransportT *_transport;
+    NodeState _nodes[MaxNodes];
+    uint8_t _frame[FrameSize];
+    uint32_t _slotStart = 0;
+    uint32_t _slotLength = 0;
+    uint8_t _nodeCount = 0;
+    uint8_t _current = 0;
+    bool _waiting = false;
+
+    bool IsValidNode(uint8_t nodeId) const
+    {
+        return nodeId > 0 && nodeId <= _nodeCount;
+    }
+
+    // returns false if the frame is not the reply of the polled node
+    bool TryReply(uint8_t length)
+    {
+        uint8_t nodeId = _current + 1;
+        NodeState &node = _nodes[_current];
+        if (length < 2 || _frame[0] != nodeId)
+            return false;
+
+        node.Missed = 0;
+        if (!node.Online)
+        {
+            node.Online = true;
+            HandlerT::OnNodeOnline(nodeId, true);
+        }
+
+        // a repeated reply (our ack was lost): already handled
+        uint8_t sequence = _frame[1];
+        if (sequence == node.Sequence)
+            return true;
+        node.Sequence = sequence;
+
+        uint8_t index = 2;
+        while (index < length)
+        {
+            uint8_t messageLength = _frame[index++];
+            if (messageLength == 0 || index + messageLength > length)
+                break;
+
+            HandlerT::OnNodeMessage(nodeId, _frame + index, messageLength);
+            index += messageLength;
+        }
+        return true;
+    }
+
+    void OnMissed()
+    {
+        NodeState &node = _nodes[_current];
+        if (node.MissedTotal < 0xFFFF)
+            node.MissedTotal++;
+        if (node.Missed < MaxMissedPolls)
+            node.Missed++;
+
+        if (node.Missed == MaxMissedPolls && node.Online)
+        {
+            node.Online = false;
+            HandlerT::OnNodeOnline(_current + 1, false);
+        }
+    }
+};
+
+/** The BusNode queues the events of this node and sends them when it is polled by the BusMaster.
+ *  `Run()` must be called within the slot length after the poll arrives
+ *  (for instance from a task that is signaled from the receive interrupt).
+ *  \tparam TransportT is the Rs485 class. The node is opened with its NodeId as address.
+ *  \tparam TimeT is the time source. Implements `uint32_t getTicks()`.
+ *  \tparam QueueSize is the number of messages that can be queued (a power of two).
+ */
+template <class TransportT, class TimeT, const uint8_t QueueSize = 4>
+class BusNode
+{
+public:
+    /** The maximum length of a queued message. */
+    static const uint8_t MaxMessageLength = 6;
+
+    /** Constructs the instance.
+     *  \param transport is the opened Rs485 transport.
+     */
+    BusNode(TransportT *transport)
+        : _transport(transport)
+    {
+    }
+
+    /** Starts answering polls.
+     *  \param pollTimeout is the maximum time (ticks of TimeT) between two polls (more than the cycle time).
+     */
+    void Open(uint32_t pollTimeout)
+    {
+        _pollTimeout = pollTimeout;
+        _lastPoll = TimeT::getTicks();
+    }
+
+    /** Queues a message (serialized command) for the next poll.
+     *  \param data is the message.
+     *  \param length is the message length (max MaxMessageLength).
+     *  \return Returns false if the queue is full or the message is too long.
+     */
+    bool TryQueue(const uint8_t *data, uint8_t length)
+    {
+        if (length == 0 || length > MaxMessageLength)
+            return false;
+
+        Message message;
+        message.Length = length;
+        for (uint8_t i = 0; i < length; i++)
+        {
+            message.Data[i] = data[i];
+        }
+        return _queue.Write(message);
+    }
+
+    /** Indicates the master has not polled this node for longer than the poll timeout.
+     *  The node should go to a safe state.
+     */
+    bool getIsMasterLost() const
+    {
+        return TimeT::getTicks() - _lastPoll > _pollTimeout;
+    }
+
+    /** Call this method repeatedly (or when a frame is received). Answers the poll.
+     */
+    void Run()
+    {
+        uint8_t frame[FrameSize];
+        uint8_t length;
+        if (!_transport->TryReadFrame(frame, &length))
+            return;
+
+        uint8_t nodeId = _transport->getAddress();
+        if (length < 4 || frame[0] != nodeId ||
+            frame[2] != static_cast<uint8_t>(NodeMessages::Poll))
+            return;
+
+        _lastPoll = TimeT::getTicks();
+
+        // the master acknowledged the last reply: the next batch
+        if (frame[3] == _sequence)
+        {
+            _sequence = (_sequence + 1) & 0x7F;
+            Fill();
+        }
+
+        _reply[0] = nodeId;
+        _reply[1] = _sequence;
+        _transport->TryWriteFrame(BusMasterAddress, _reply, _replyLength);
+    }
+
+private:
+    static const uint8_t FrameSize = TransportT::MaxFrameLength;
+
+    struct Message
+    {
+        uint8_t Length;
+        uint8_t Data[MaxMessageLength];
+    };
+
+    TransportT *_transport;
+    RingBufferSpsc<Message, QueueSize> _queue;
+    uint8_t _reply[FrameSize];
+    uint8_t _replyLength = 2;
+    // starts 'acknowledged' so the first poll fills a batch
+    uint8_t _sequence = 0xFF;
+    uint32_t _lastPoll = 0;
+    uint32_t _pollTimeout = 0;
+
+    // moves as many queued messages as fit into the reply
+    void Fill()
+    {
+        _replyLength = 2;
+        Message message;
+        while (!_queue.getIsEmpty())
+        {
+            // peek: the message stays queued when it does not fit
+            uint8_t needed = 1 + _queue.Peek().Length;
+            if (_replyLength + needed > FrameSize)
+                break;
+
+            _queue.TryRead(&message);
+            _reply[_replyLength++] = message.Length;
+            for (uint8_t i = 0; i < message.Length; i++)
+            {
+                _reply[_replyLength++] = message.Data[i];
+            }
+        }
+    }
+};
+
+// a BusNode (or master) is woken by the frame interrupt of the Rs485:
+// ISR(USART_RX_vect)
+// {
+//     rs485.OnReceiveInterrupt();
+//     Tasks::Signal(busTaskId);
+// }
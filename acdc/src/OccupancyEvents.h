@@ -0,0 +1,30 @@
+#pragma once
+#include <stdint.h>
+#include "../lib/atl/EventQueue.h"
+
+/** Published when the occupancy of a block has changed.
+ */
+struct OccupancyEvent
+{
+    // zero-based index of the block
+    uint8_t BlockId;
+    bool Occupied;
+    // time (ticks) the change was detected
+    uint32_t Timestamp;
+};
+
+/** The consumers of the occupancy events.
+ *  Each subscriber reads each event once.
+ */
+enum class OccupancySubscriber : uint8_t
+{
+    BlockLogic, // BlockControllerTask
+    Serial,     // occupancy notifications to the host
+    Lcd,        // occupancy display
+    Count
+};
+
+const uint8_t OccupancyEventQueueSize = 16;
+typedef EventQueue<OccupancyEvent, OccupancyEventQueueSize, (uint8_t)OccupancySubscriber::Count> OccupancyEventQueue;
+
+extern OccupancyEventQueue occupancyEvents;
@@ -1,4 +1,15 @@
 #define DEBUG
+// measures task execution times and the loop period ('R' command prints them). uses Timer1.
+// #define PROFILE
+// parses the serial commands in the receive interrupt (CommandQueue). the main loop only dispatches them.
+// #define ISR_COMMANDS
+// speaks the DCC-EX text protocol (<t cab speed dir>, <1 MAIN>, <Q>...) instead of the simple commands.
+// #define DCCEX_COMMANDS
+// block 0 brakes to a mark with a VL53L0X range sensor (ApproachControl). runs the block logic and the PCA9685.
+// #define APPROACH_CONTROL
+#if defined(ISR_COMMANDS) && defined(DCCEX_COMMANDS)
+#error "ISR_COMMANDS supports the simple commands only."
+#endif
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <avr/pgmspace.h>
@@ -11,11 +22,22 @@
 #include "../lib/ServoTimer.h"
 #include "../lib/ServoOutputPin.h"
 #include "../lib/Twi.h"
+#include "../lib/TwiAsync.h"
 #include "../lib/PCA9685.h"
 #include "../lib/INA219.h"
+#include "../lib/IdleSleep.h"
+#include "../lib/TaskWatchdog.h"
+#ifdef PROFILE
+#include "../lib/TaskProfiler.h"
+#endif
 
 #include "../lib/atl/Debug.h"
+#ifdef DEBUG
+#include "../lib/atl/DebugLog.h"
+#endif
 #include "../lib/atl/Delays.h"
+#include "../lib/atl/TimerWheel.h"
+#include "../lib/atl/TaskScheduler.h"
 #include "../lib/atl/FixedString.h"
 #include "../lib/atl/Time.h"
 #include "../lib/atl/TimeResolution.h"
@@ -29,25 +51,79 @@
 #include "PwmTask.h"
 // #include "CommandParser.h"
 // #include "CommandHandler.h"
+// #include "FramedCommandParser.h"
 #include "SimpleCommandParser.h"
+#include "DccExCommands.h"
 #include "SimpleCommandHandler.h"
+#include "CommandQueue.h"
 #include "BlockDriverTask.h"
+#include "OccupancyEvents.h"
+#include "EmergencyStop.h"
 
+// the delays of the 4 BlockDriverTasks and the ApproachControl of block 0
 const uint8_t MaxItems = 5;
 #define TimeRes TimeResolution::Milliseconds
-typedef Delays<Time<TimeRes>, MaxItems> Scheduler;
+// typedef Delays<Time<TimeRes>, MaxItems> Scheduler;
+typedef TimerWheel<Time<TimeRes>, MaxItems> Scheduler;
+
+const uint8_t MaxTasks = 8;
+// execution times are measured on the live Timer0 count: the Scheduler ticks only update once per loop
+typedef TaskWatchdog<Scheduler, TimerCounterT, MaxTasks> TaskWatchdogT;
+#ifdef PROFILE
+typedef TaskProfiler<MaxTasks> Profiler;
+typedef TaskMonitors<Profiler, TaskWatchdogT> TaskMonitorT;
+#else
+typedef TaskWatchdogT TaskMonitorT;
+#endif
+typedef TaskScheduler<Scheduler, MaxTasks, TaskMonitorT> Tasks;
+typedef IdleSleep<TimerCounterT> IdleSleepT;
+#ifdef DEBUG
+// tokenized log records (DebugLog_Id) wait here for the DebugLogTask
+typedef DebugLog<Scheduler, 8> DebugLogT;
+#endif
+
+// task priorities (0 = highest)
+const uint8_t EmergencyStopPriority = 0;
+const uint8_t SerialPriority = 1;
+const uint8_t BlocksPriority = 2;
+const uint8_t DisplayPriority = 3;
+const uint8_t BlinkPriority = 4;
+const uint8_t DebugLogPriority = 5;
+
+// task ids for signaling (from ISRs)
+uint8_t emergencyStopTaskId = Tasks::InvalidTaskId;
+uint8_t readSerialTaskId = Tasks::InvalidTaskId;
+uint8_t readSensorsTaskId = Tasks::InvalidTaskId;
+uint8_t displayTaskId = Tasks::InvalidTaskId;
 
 Serial serial;
-TimeoutTask<ToggleOutputPinTaskBase<PortPins::B5>, Scheduler, ToMilliseconds(TimeRes, 300)> blinkLedTask;
+#ifdef UBRR1
+// the ATmega2560 has independent ports for a telemetry link and the RS-485 node bus, for instance:
+// SerialPort<UsartIds::Usart1, 64, 4> telemetry;   // SerialPort_Interrupts(USART1, telemetry)
+// Rs485<UsartIds::Usart2, DigitalOutputPin<PortPins::...>> nodeBus;
+#endif
+DigitalOutputPin<PortPins::B5> blinkLed;
 
 // ServoTimer1 servoTimer;
 // Servo360OutputPin<ServoTimer1, PortPins::B1> pwmServo1Pin(&servoTimer);
 // Servo360OutputPin<ServoTimer1, PortPins::B2> pwmServo2Pin(&servoTimer);
 
 // CommandParser<CommandHandler> commandParser;
+// binary commands in COBS frames with a CRC-16 (see CommandFrame).
+// the serial e-stop byte is not filtered for binary frames: the e-stop is the input pin (or power off).
+// FramedCommandParser<CommandHandler> commandParser;
+#ifdef DCCEX_COMMANDS
+DccExCommandParser<SimpleCommandHandler> commandParser;
+#else
 SimpleCommandParser<SimpleCommandHandler> commandParser;
+#endif
+#ifdef ISR_COMMANDS
+CommandQueue<decltype(commandParser)> commandQueue(&commandParser);
+#endif
 
 BlockControllerTask<Scheduler> blockControllerTask;
+TrainTrackerT trainTracker;
+OccupancyEventQueue occupancyEvents;
 
 // VL53L0XT_0 sensor0;
 // VL53L0XT_1 sensor1;
@@ -55,6 +131,9 @@ BlockControllerTask<Scheduler> blockControllerTask;
 BitArray<uint8_t> lcdData(1 << LED_Index);
 LCD lcd;
 
+class Program;
+extern Program program;
+
 class Program
 {
 public:
@@ -62,34 +141,97 @@ public:
     {
         Scheduler::Update();
 
-        // indication that the program is running
-        blinkLedTask.Run();
-
-        // blockControllerTask.Run(blockController0, blockController1, blockController2, blockController3);
+        // only the tasks that are ready run - in priority order
+        if (Tasks::RunReady() == 0)
+        {
+            // nothing to do: sleep until the next interrupt (Timer0 overflows every ~1ms)
+            IdleSleepT::Enter<Tasks>();
+        }
+    }
 
-        // ReadSerial();
-        // ReadSensors();
+    void RegisterTasks()
+    {
+        emergencyStopTaskId = Tasks::Register(&Program::EmergencyStopTask, EmergencyStopPriority, Tasks::WakeCondition::Event);
+        TaskWatchdogT::Supervise(emergencyStopTaskId, Scheduler::ForMilliseconds(50), 0);
+        // readSerialTaskId = Tasks::Register(&Program::ReadSerialTask, SerialPriority, Tasks::WakeCondition::Event);
+#ifdef APPROACH_CONTROL
+        Tasks::Register(&Program::BlocksTask, BlocksPriority, Tasks::WakeCondition::Timer, Scheduler::ForMilliseconds(10));
+#else
+        // Tasks::Register(&Program::BlocksTask, BlocksPriority, Tasks::WakeCondition::Timer, Scheduler::ForMilliseconds(10));
+#endif
+        // readSensorsTaskId = Tasks::Register(&Program::ReadSensorsTask, SerialPriority, Tasks::WakeCondition::Event);
+        displayTaskId = Tasks::Register(&Program::DisplayTask, DisplayPriority, Tasks::WakeCondition::Event);
+        TaskWatchdogT::Supervise(displayTaskId, Scheduler::ForMilliseconds(100), 0);
+        // indication that the program is running (its heartbeat proves the timers still run)
+        uint8_t blinkTaskId = Tasks::Register(&Program::BlinkTask, BlinkPriority, Tasks::WakeCondition::Timer, Scheduler::ForMilliseconds(300));
+        TaskWatchdogT::Supervise(blinkTaskId, Scheduler::ForMilliseconds(10), Scheduler::ForMilliseconds(1000));
+#ifdef DEBUG
+        Tasks::Register(&Program::DebugLogTask, DebugLogPriority, Tasks::WakeCondition::Timer, Scheduler::ForMilliseconds(10));
+#endif
+    }
 
-        // if (sensor0.isMeasurementReady() && sensor1.isMeasurementReady())
-        // {
-        //     uint16_t range0, range1;
+    // task trampolines
 
-        //     sensor0.ReadRange_mm(&range0);
-        //     sensor1.ReadRange_mm(&range1);
+    static void EmergencyStopTask()
+    {
+        program.ReportEmergencyStop();
+    }
+    static void ReadSerialTask()
+    {
+        program.ReadSerial();
+    }
+    static void BlocksTask()
+    {
+        program.RunBlocks();
+    }
+    static void ReadSensorsTask()
+    {
+        program.ReadSensors();
+    }
+    static void DisplayTask()
+    {
+        program.UpdateDisplay();
+    }
+    static void BlinkTask()
+    {
+        blinkLed.Toggle();
+    }
+#ifdef DEBUG
+    static void DebugLogTask()
+    {
+        program.WriteDebugLog();
+    }
+#endif
 
-        //     serial.Transmit.Write("1: ");
-        //     serial.Transmit.Write(range0);
-        //     serial.Transmit.Write(" - 2: ");
-        //     serial.Transmit.Write(range1);
-        //     serial.Transmit.WriteLine();
-        // }
+    // called from the WDT interrupt, just before the reset
+    static void SafeStop()
+    {
+        EmergencyStopT::Trigger(EmergencyStopT::Source::Watchdog);
+    }
 
-        // tredding water
-        Scheduler::SpinWait(50);
+    void RunBlocks()
+    {
+        commandParser.ReadBlocks();
+        blockControllerTask.Run(blockController0, blockController1, blockController2, blockController3);
+
+        // wake the other consumers of the occupancy events
+        if (!occupancyEvents.getIsEmpty((uint8_t)OccupancySubscriber::Serial))
+            Tasks::Signal(readSensorsTaskId);
+        if (!occupancyEvents.getIsEmpty((uint8_t)OccupancySubscriber::Lcd))
+            Tasks::Signal(displayTaskId);
     }
 
     void ReadSerial()
     {
+#ifdef ISR_COMMANDS
+        // already parsed by the receive interrupt
+        decltype(commandParser)::Record record;
+        while (commandQueue.TryRead(&record))
+        {
+            if (!commandParser.Dispatch(record))
+                serial.Transmit.WriteLine('?');
+        }
+#else
         while (serial.Receive.getCount() > 0)
         {
             uint8_t data;
@@ -98,8 +240,21 @@ public:
                 ParseCommand(data);
             }
         }
+#endif
     }
 
+#ifdef DCCEX_COMMANDS
+    // the parser writes the reply (<X> on an error)
+    bool ParseCommand(char data)
+    {
+        if (!commandParser.Parse(data))
+            return false;
+
+        commandParser.Dispatch(serial.Transmit);
+        commandParser.Clear();
+        return true;
+    }
+#else
     bool ParseCommand(char data)
     {
         bool parsed = commandParser.Parse(data);
@@ -108,7 +263,7 @@ public:
 
         if (commandParser.IsError())
         {
-            serial.Transmit.WriteLine("?");
+            serial.Transmit.WriteLine('?');
             commandParser.Clear();
         }
         else if (commandParser.IsComplete())
@@ -118,12 +273,52 @@ public:
             //  else
             //      serial.Transmit.WriteLine("err");
             if (!commandParser.Dispatch())
-                serial.Transmit.WriteLine("?");
+                serial.Transmit.WriteLine('?');
             commandParser.Clear();
         }
 
         return parsed;
     }
+#endif
+
+    // the outputs are already off (ISR). bring the rest of the system in line and report.
+    void ReportEmergencyStop()
+    {
+        IdleSleepT::MeasureWake();
+
+        EmergencyStopT::Source source;
+        if (EmergencyStopT::TryTakeTriggered(&source))
+        {
+            // so trains do not start moving on release
+            commandParser.OnPower(false);
+
+            serial.Transmit.Write(F("E-STOP "));
+            serial.Transmit.Write(source == EmergencyStopT::Source::Serial ? F("serial") : source == EmergencyStopT::Source::Input ? F("input") : F("watchdog"));
+            // wake-to-handle latency (us)
+            serial.Transmit.Write(' ');
+            serial.Transmit.WriteLine(IdleSleepT::getLastWakeLatency());
+        }
+    }
+
+    void UpdateDisplay()
+    {
+        // show the occupancy of each block on the second row: '-' free, '#' occupied
+        OccupancyEvent event;
+        while (occupancyEvents.TryRead((uint8_t)OccupancySubscriber::Lcd, &event))
+        {
+            lcd.SetCursor(1, event.BlockId);
+            lcd.Write(event.Occupied ? '#' : '-');
+        }
+
+        // events were lost: redraw all blocks from their current state
+        if (occupancyEvents.TryTakeOverrun((uint8_t)OccupancySubscriber::Lcd))
+        {
+            uint8_t flags = commandParser.getOccupiedFlags();
+            lcd.SetCursor(1, 0);
+            for (uint8_t i = 0; i < 4; i++)
+                lcd.Write(BitFlag::IsTrue(flags, i) ? '#' : '-');
+        }
+    }
 
     void ReadSensors()
     {
@@ -148,31 +343,69 @@ public:
         // }
     }
 
+#ifdef DEBUG
+    // only whole frames and never wait: a frame is only written when it fits
+    void WriteDebugLog()
+    {
+        while (serial.Transmit.getBufferSize() - serial.Transmit.getCount() >= DebugLogT::MaxFrameLength &&
+               DebugLogT::TryWriteFrame(serial.Transmit))
+        {
+        }
+    }
+#endif
+
     void Initialize()
     {
         // make sure light is off
-        blinkLedTask.Write(false);
+        blinkLed.Write(false);
+
+        // first so the outputs are controlled as soon as possible.
+        // after a watchdog reset the PCA9685 still runs the last duty cycles: the outputs stay off until power on.
+        EmergencyStopT::Open(TaskWatchdogT::getIsWatchdogReset() ? EmergencyStopT::Source::Watchdog : EmergencyStopT::Source::None);
 
         // Start the timer that powers Time<TimeResolution> / Scheduler
         Scheduler::Start();
 
         // open serial port (usart)
-        if (!serial.Open(BaudRates::Baud115200))
+        if (!serial.Open(BaudRates::Baud1000000))
             Stop(1);
+        // replies and reports block until they fit (a reply is never truncated).
+        // only the diagnostics drop (AtlDebugWrite, WriteDebugLog), they must never stall the control tasks.
+        serial.Transmit.setWritePolicy(UsartWritePolicy::Block);
 
         // enable global interrupts
         Interupts::Enable();
 
+        // report the task that caused a watchdog reset
+        uint8_t resetTaskId;
+        if (TaskWatchdogT::TryTakeResetTaskId(&resetTaskId))
+        {
+            serial.Transmit.Write(F("WDT reset task "));
+            serial.Transmit.WriteLine(resetTaskId);
+        }
+
         if (Twi::HasFailed(Twi::Open(I2cFrequency::Normal)))
             Stop(2);
 
+#ifdef APPROACH_CONTROL
+        if (!PwmModuleT::Open(70) ||
+            !PwmModuleT::setOutputMode(PwmModuleT::OutputDriver::PushPull))
+            Stop(3);
+#else
         // if (!PwmModuleT::Open(70) ||
         //     !PwmModuleT::setOutputMode(PwmModuleT::OutputDriver::PushPull))
         //     Stop(3);
+#endif
 
         // if (!commandParser.Open())
         //     Stop(4);
 
+        // opens the range sensors of the blocks with approach control
+#ifdef APPROACH_CONTROL
+        if (!blockControllerTask.Open())
+            Stop(7);
+#endif
+
         // if (!sensor0.Open())
         //     Stop(5);
         // sensor0.StartContinuous();
@@ -185,6 +418,21 @@ public:
         lcd.Initialize();
         lcd.setEnableDisplay();
         lcd.Write("Hello World");
+
+        RegisterTasks();
+        // report a stop latched at startup
+        if (EmergencyStopT::getIsStopped())
+            Tasks::Signal(emergencyStopTaskId);
+
+#ifdef PROFILE
+        Profiler::Open();
+#endif
+
+        // everything is opened: switch off what is not used
+        IdleSleepT::Open();
+
+        // from here on a task that hangs or misses its deadline stops the motors and resets
+        TaskWatchdogT::Open(WDTO_500MS, &Program::SafeStop);
     }
 
     void Stop(uint8_t code)
@@ -199,11 +447,11 @@ public:
 
         if (code > 1)
         {
-            serial.Transmit.Write("Stop: ");
+            serial.Transmit.Write(F("Stop: "));
             serial.Transmit.WriteLine(code);
         }
 
-        blinkLedTask.Write(true);
+        blinkLed.Write(true);
         // full stop
         while (1)
         {
@@ -227,7 +475,51 @@ int main()
 
 ISR(USART_RX_vect)
 {
-    serial.Receive.OnIsCompleteInterrupt();
+#ifdef PROFILE
+    EmergencyStopT::MarkInterrupt();
+#endif
+    // e-stop fast path: never reaches the command parser.
+    // not for binary frames (FramedCommandParser): the reserved byte is a legal byte in a frame.
+    bool isEmergencyStop = false;
+    if (decltype(commandParser)::IsTextProtocol)
+        isEmergencyStop = serial.Receive.OnIsCompleteInterrupt(EmergencyStopT::ReservedByte);
+    else
+        serial.Receive.OnIsCompleteInterrupt();
+
+    if (isEmergencyStop)
+    {
+        // only the e-stop latency is measured (reported by the EmergencyStopTask)
+        IdleSleepT::MarkWake();
+        EmergencyStopT::Trigger(EmergencyStopT::Source::Serial);
+        Tasks::Signal(emergencyStopTaskId);
+    }
+    else
+    {
+#ifdef ISR_COMMANDS
+        // only wake the serial task for a complete command
+        uint8_t data;
+        bool queued = false;
+        while (serial.Receive.TryRead(&data))
+            queued |= commandQueue.Parse(data);
+        if (queued)
+            Tasks::Signal(readSerialTaskId);
+#else
+        Tasks::Signal(readSerialTaskId);
+#endif
+    }
+}
+
+ISR(PCINT0_vect)
+{
+#ifdef PROFILE
+    EmergencyStopT::MarkInterrupt();
+#endif
+    EmergencyStopT::OnInputChanged();
+    if (EmergencyStopT::getIsStopped())
+    {
+        IdleSleepT::MarkWake();
+        Tasks::Signal(emergencyStopTaskId);
+    }
 }
 
 ISR(USART_UDRE_vect)
@@ -235,39 +527,98 @@ ISR(USART_UDRE_vect)
     serial.Transmit.OnAcceptDataInterrupt();
 }
 
+// task deadline missed: safe stop and reset
+ISR(WDT_vect)
+{
+    TaskWatchdogT::OnWatchdogInterrupt();
+}
+
+// queued (non-blocking) I2C transactions
+ISR(TWI_vect)
+{
+    TwiAsync::OnTwiInterrupt();
+}
+
+void PerfDump()
+{
+#ifdef PROFILE
+    Profiler::Dump(serial.Transmit);
+    // the last e-stop: ISR start to output write
+    serial.Transmit.Write(F("e-stop latency "));
+    serial.Transmit.Write(EmergencyStopT::getLatencyCycles());
+    serial.Transmit.WriteLine(F(" cycles"));
+#else
+    serial.Transmit.WriteLine(F("PROFILE not defined"));
+#endif
+
+    // the health of the serial link: receive errors would otherwise go unnoticed
+    decltype(serial.Receive)::ErrorCounts errors = serial.Receive.getErrorCounts();
+    serial.Transmit.Write(F("serial baud error "));
+    serial.Transmit.Write(serial.getBaudErrorPermille());
+    serial.Transmit.Write(F("/1000 frame "));
+    serial.Transmit.Write(errors.FrameErrors);
+    serial.Transmit.Write(F(" parity "));
+    serial.Transmit.Write(errors.ParityErrors);
+    serial.Transmit.Write(F(" overrun "));
+    serial.Transmit.Write(errors.OverRuns);
+    serial.Transmit.Write(F(" rx full "));
+    serial.Transmit.Write(errors.BufferOverflows);
+    serial.Transmit.Write(F(" tx dropped "));
+    serial.Transmit.WriteLine(serial.Transmit.getDroppedCount());
+}
+
+#ifdef PROFILE
+ISR(TIMER1_OVF_vect)
+{
+    FreeRunningTimer1::OnTimerOverflowInterrupt();
+}
+#endif // PROFILE
+
 #ifdef DEBUG
 
 void AtlDebugWrite(uint8_t componentId, DebugLevel level, const char *message)
 {
+    // diagnostics only: drop what does not fit instead of waiting (also called from interrupts)
+    UsartWritePolicy policy = serial.Transmit.getWritePolicy();
+    serial.Transmit.setWritePolicy(UsartWritePolicy::DropNewest);
+
     serial.Transmit.Write(Scheduler::getTicks());
-    serial.Transmit.Write(" [");
+    serial.Transmit.Write(F(" ["));
     serial.Transmit.Write(componentId);
-    serial.Transmit.Write("] ");
+    serial.Transmit.Write(F("] "));
 
     switch (level)
     {
     case DebugLevel::Critical:
-        serial.Transmit.Write("CRITICAL: ");
+        serial.Transmit.Write(F("CRITICAL: "));
         break;
     case DebugLevel::Error:
-        serial.Transmit.Write("ERROR: ");
+        serial.Transmit.Write(F("ERROR: "));
         break;
     case DebugLevel::Warning:
-        serial.Transmit.Write("WARNING: ");
+        serial.Transmit.Write(F("WARNING: "));
         break;
     case DebugLevel::Info:
-        serial.Transmit.Write("INFO: ");
+        serial.Transmit.Write(F("INFO: "));
         break;
     case DebugLevel::Trace:
-        serial.Transmit.Write("TRACE: ");
+        serial.Transmit.Write(F("TRACE: "));
         break;
     case DebugLevel::Debug:
-        serial.Transmit.Write("DEBUG: ");
+        serial.Transmit.Write(F("DEBUG: "));
         break;
     default:
         break;
     }
     serial.Transmit.WriteLine(message);
+
+    serial.Transmit.setWritePolicy(policy);
+}
+
+// queued, written by the DebugLogTask (decode with tools/debuglog.py)
+void AtlDebugWriteId(uint8_t componentId, DebugLevel level, uint16_t messageId, int16_t arg0, int16_t arg1)
+{
+    DebugLogT::Write(componentId, level, messageId, arg0, arg1);
 }
 
 bool AtlDebugFilter(uint8_t componentId, DebugLevel level)
@@ -12,7 +12,12 @@ enum class BaudRates : uint32_t
     Baud19200 = 19200,
     Baud38400 = 38400,
     Baud57600 = 57600,
-    Baud115200 = 115200
+    Baud115200 = 115200,
+    // exact at 16MHz (2M uses U2X double speed). the host adapter must support the rate (FTDI, CH340)
+    Baud250000 = 250000,
+    Baud500000 = 500000,
+    Baud1000000 = 1000000,
+    Baud2000000 = 2000000
 };
 
 template <class BaseT>
@@ -32,27 +37,75 @@ public:
     }
 };
 
-const UsartIds usartId = UsartIds::Usart0;
-const uint8_t CharacterBufferSize = 21;
-
-typedef TextWriter<DataWriter<UsartOutputStream<UsartTransmit<usartId>, RingBuffer<uint8_t, CharacterBufferSize>>>> SerialWriter;
-typedef UsartInputStream<UsartReceive<usartId>, RingBuffer<uint8_t, CharacterBufferSize>> SerialReader;
-
-class Serial : public Usart<usartId, SerialWriter, SerialReader>
+/** A buffered, interrupt driven serial port with text output.
+ *  Each port has its own buffers and interrupts: bind them with `SerialPort_Interrupts()`
+ *  (or call `Receive.OnIsCompleteInterrupt()` and `Transmit.OnAcceptDataInterrupt()` from your own ISRs).
+ *  \tparam UsartId is the Usart port (Usart1-3 on the ATmega2560).
+ *  \tparam TransmitBufferSize is the size of the transmit buffer (a power of two).
+ *  \tparam ReceiveBufferSize is the size of the receive buffer (a power of two).
+ */
+template <const UsartIds UsartId, const uint8_t TransmitBufferSize = 32, const uint8_t ReceiveBufferSize = 32>
+class SerialPort : public Usart<UsartId,
+                                TextWriter<DataWriter<UsartOutputStream<UsartTransmit<UsartId>, RingBufferSpsc<uint8_t, TransmitBufferSize>>>>,
+                                UsartInputStream<UsartReceive<UsartId>, RingBufferSpsc<uint8_t, ReceiveBufferSize>>>
 {
 public:
     bool Open(BaudRates baudRate, bool enableInterrupts = true)
     {
         UsartConfig config;
         if (config.InitAsync((uint32_t)baudRate) &&
-            OpenAsync(config))
+            this->OpenAsync(config))
         {
-            Transmit.setEnable();
-            Transmit.setEnableAcceptDataInterrupt(enableInterrupts);
-            Receive.setEnable();
-            Receive.setEnableIsCompleteInterrupt(enableInterrupts);
+            _baudErrorPermille = config.getBaudErrorPermille();
+            this->Transmit.setEnable();
+            this->Transmit.setEnableAcceptDataInterrupt(enableInterrupts);
+            this->Receive.setEnable();
+            this->Receive.setEnableIsCompleteInterrupt(enableInterrupts);
             return true;
         }
         return false;
     }
+
+    /** Returns the deviation (in 0.1%) of the configured baud rate from the requested baud rate.
+     */
+    uint16_t getBaudErrorPermille() const
+    {
+        return _baudErrorPermille;
+    }
+
+private:
+    uint16_t _baudErrorPermille = 0;
 };
+
+/** Defines the receive and transmit ISRs for a SerialPort instance.
+ *  \param usart is the vector prefix: USART (ATmega328P) or USART0-USART3 (ATmega2560).
+ *  \param port is the SerialPort instance.
+ */
+#define SerialPort_Interrupts(usart, port)        \
+    ISR(usart##_RX_vect)                          \
+    {                                             \
+        port.Receive.OnIsCompleteInterrupt();     \
+    }                                             \
+    ISR(usart##_UDRE_vect)                        \
+    {                                             \
+        port.Transmit.OnAcceptDataInterrupt();    \
+    }
+
+// the ATmega2560 numbers the vectors of Usart 0
+#if !defined(USART_RX_vect) && defined(USART0_RX_vect)
+#define USART_RX_vect USART0_RX_vect
+#define USART_UDRE_vect USART0_UDRE_vect
+#define USART_TX_vect USART0_TX_vect
+#endif
+
+const UsartIds usartId = UsartIds::Usart0;
+const uint8_t CharacterBufferSize = 32;
+#ifdef ISR_COMMANDS
+// the receive interrupt parses each byte right away (CommandQueue)
+const uint8_t ReceiveBufferSize = 2;
+#else
+const uint8_t ReceiveBufferSize = CharacterBufferSize;
+#endif
+
+// the host link
+typedef SerialPort<usartId, CharacterBufferSize, ReceiveBufferSize> Serial;
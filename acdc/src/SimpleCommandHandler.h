@@ -6,8 +6,15 @@
 
 #include "Block.h"
 #include "hardware.h"
+#include "TrainTracker.h"
+#include "OccupancyEvents.h"
+#include "EmergencyStop.h"
 
 extern Serial serial;
+extern TrainTrackerT trainTracker;
+extern OccupancyEventQueue occupancyEvents;
+// writes the task profile and the serial errors to the serial port (Program.cpp)
+void PerfDump();
 
 BlockControllerT_0 blockController0;
 BlockControllerT_1 blockController1;
@@ -25,48 +32,171 @@ public:
                blockController3.Open();
     }
 
+    // reads all blocks. changes are published to the occupancyEvents queue.
+    void ReadBlocks()
+    {
+        blockController0.TryReadOccupied();
+        blockController1.TryReadOccupied();
+        blockController2.TryReadOccupied();
+        blockController3.TryReadOccupied();
+    }
+
+    // consumes the occupancy events for the serial notifications.
     bool TryReadBlocks(uint8_t *outData)
     {
-        if (blockController0.TryReadOccupied() || blockController1.TryReadOccupied() || blockController2.TryReadOccupied() || blockController3.TryReadOccupied())
+        bool changed = false;
+        OccupancyEvent event;
+        while (occupancyEvents.TryRead((uint8_t)OccupancySubscriber::Serial, &event))
         {
-            BitArray<uint8_t> flags;
-            flags.Set(0, blockController0.getOccupied());
-            flags.Set(1, blockController1.getOccupied());
-            flags.Set(2, blockController2.getOccupied());
-            flags.Set(3, blockController3.getOccupied());
-
-            *outData = flags;
-            return true;
+            BitFlag::Set(_occupiedFlags, event.BlockId, event.Occupied);
+            changed = true;
         }
 
-        return false;
+        // events were lost: take the current state from the blocks
+        if (occupancyEvents.TryTakeOverrun((uint8_t)OccupancySubscriber::Serial))
+        {
+            _occupiedFlags = getOccupiedFlags();
+            changed = true;
+        }
+
+        if (changed)
+            *outData = _occupiedFlags;
+        return changed;
+    }
+
+    // bit n set: block n is occupied
+    uint8_t getOccupiedFlags() const
+    {
+        uint8_t flags = 0;
+        BitFlag::Set(flags, 0, blockController0.getOccupied());
+        BitFlag::Set(flags, 1, blockController1.getOccupied());
+        BitFlag::Set(flags, 2, blockController2.getOccupied());
+        BitFlag::Set(flags, 3, blockController3.getOccupied());
+        return flags;
     }
 
     void OnPower(bool on)
     {
+        // power on also releases an emergency stop
+        if (on && !EmergencyStopT::Release())
+            return;
+
+        _power = on;
+        PwmModuleT::BeginBatch();
         blockController0.setPower(on);
         blockController1.setPower(on);
         blockController2.setPower(on);
         blockController3.setPower(on);
+        PwmModuleT::CommitBatch();
+    }
+    bool getIsPowerOn() const
+    {
+        return _power;
     }
     // speed >= 0 && <= 9
     void OnSpeed(uint8_t speed)
     {
         uint8_t actual = Math::ScaleLinear<uint8_t, uint8_t>(0, 9, 0, 255, speed);
+        _speed = actual;
 
+        // one PCA9685 transaction: all blocks change at the same time
+        PwmModuleT::BeginBatch();
         blockController0.setSpeed(actual);
         blockController1.setSpeed(actual);
         blockController2.setSpeed(actual);
         blockController3.setSpeed(actual);
+        PwmModuleT::CommitBatch();
     }
     void OnDirection(bool forward)
     {
         Direction dir = forward ? Direction::Forward : Direction::Backward;
+        _direction = dir;
         blockController0.setDirection(dir);
         blockController1.setDirection(dir);
         blockController2.setDirection(dir);
         blockController3.setDirection(dir);
     }
+    // places a new train in the block (0-3) with the current speed and direction.
+    // returns false for a block that does not exist (or a full tracker).
+    bool OnTrain(uint8_t blockIndex)
+    {
+        SpeedProfile speed = {_speed};
+        if (!trainTracker.Assign(blockIndex, _nextTrainId, _direction, speed))
+            return false;
+
+        _nextTrainId++;
+        if (_nextTrainId == Train::NoTrainId)
+            _nextTrainId++;
+        return true;
+    }
+
+    void OnPerfDump()
+    {
+        PerfDump();
+    }
+
+    // DCC-EX (DccExCommandParser): the cab is the block (1-4), speed -1 (emergency stop) to 126
+    bool OnThrottle(uint16_t cab, int8_t speed, bool forward)
+    {
+        uint8_t actual = speed <= 0 ? 0 : Math::ScaleLinear<uint8_t, uint8_t>(0, 126, 0, 255, speed);
+        Direction dir = forward ? Direction::Forward : Direction::Backward;
+        switch (cab)
+        {
+        case 1:
+            return SetBlock(blockController0, actual, dir);
+        case 2:
+            return SetBlock(blockController1, actual, dir);
+        case 3:
+            return SetBlock(blockController2, actual, dir);
+        case 4:
+            return SetBlock(blockController3, actual, dir);
+        default:
+            return false;
+        }
+    }
+    // there are no turnouts on the DC blocks
+    bool OnTurnout(uint16_t /*id*/, bool /*thrown*/)
+    {
+        return false;
+    }
+    // a sensor per block (id 1-4): occupied is active
+    bool TryGetSensor(uint8_t index, uint16_t *outId, bool *outActive)
+    {
+        switch (index)
+        {
+        case 0:
+            *outActive = blockController0.getOccupied();
+            break;
+        case 1:
+            *outActive = blockController1.getOccupied();
+            break;
+        case 2:
+            *outActive = blockController2.getOccupied();
+            break;
+        case 3:
+            *outActive = blockController3.getOccupied();
+            break;
+        default:
+            return false;
+        }
+        *outId = index + 1;
+        return true;
+    }
+
+private:
+    bool _power = false;
+    uint8_t _occupiedFlags = 0;
+    uint8_t _speed = 0;
+    Direction _direction = Direction::Forward;
+    uint8_t _nextTrainId = 1;
+
+    template <class BlockControllerT>
+    static bool SetBlock(BlockControllerT &block, uint8_t speed, Direction direction)
+    {
+        block.setDirection(direction);
+        block.setSpeed(speed);
+        return true;
+    }
 };
 
 #ifdef ARDUINO_MOTOR_SHIELD_REV3
@@ -5,12 +5,26 @@ template <class CommandHandlerT>
 class SimpleCommandParser : public CommandHandlerT
 {
 public:
+    /** Text commands: the EmergencyStop reserved byte never occurs in a command. */
+    static const bool IsTextProtocol = true;
+
     enum class CommandType : uint8_t
     {
         None,
         Power,     //'Po' or 'P' (off)
         Speed,     //'Sn' (n=0-9)
         Direction, //'Df' or 'Db'
+        Train,     //'Tn' (n=block 0-3)
+        PerfDump,  //'R' (report task profile and serial errors)
+    };
+
+    /** A decoded command: fixed size so it can be queued (see CommandQueue).
+     *  A Command of None reports a parse error.
+     */
+    struct Record
+    {
+        CommandType Command;
+        uint8_t Parameter;
     };
 
     enum class ParserState : uint8_t
@@ -59,6 +73,18 @@ public:
                 _state = ParserState::Command;
                 return true;
             }
+            if (data == 'T' || data == 't')
+            {
+                _command = CommandType::Train;
+                _state = ParserState::Command;
+                return true;
+            }
+            if (data == 'R' || data == 'r')
+            {
+                _command = CommandType::PerfDump;
+                _state = ParserState::Command;
+                return true;
+            }
             Clear();
             return false;
 
@@ -81,7 +107,8 @@ public:
             }
             if (data >= '0' && data <= '9')
             {
-                if (_command != CommandType::Speed)
+                if (_command != CommandType::Speed &&
+                    _command != CommandType::Train)
                 {
                     _error = ParserError::InvalidParameter;
                     return false;
@@ -103,7 +130,7 @@ public:
             }
             // no param
             else if (data == '\n' &&
-                     _command == CommandType::Power)
+                     (_command == CommandType::Power || _command == CommandType::PerfDump))
             {
                 _state = ParserState::Complete;
                 return true;
@@ -132,16 +159,31 @@ public:
         if (_state != ParserState::Complete)
             return false;
 
-        switch (_command)
+        return Dispatch(getRecord());
+    }
+
+    /** Dispatches a decoded command to the handler.
+     *  Does not use the parser state: the parser can run in an interrupt meanwhile.
+     *  \param record is the command from `getRecord()`.
+     *  \return Returns false if the command is not valid.
+     */
+    bool Dispatch(const Record &record)
+    {
+        switch (record.Command)
         {
         case CommandType::Power:
-            CommandHandlerT::OnPower(_params[0] == 'o');
+            CommandHandlerT::OnPower(record.Parameter == 'o');
             return true;
         case CommandType::Speed:
-            CommandHandlerT::OnSpeed(_params[0]);
+            CommandHandlerT::OnSpeed(record.Parameter);
             return true;
         case CommandType::Direction:
-            CommandHandlerT::OnDirection(_params[0] == 'f');
+            CommandHandlerT::OnDirection(record.Parameter == 'f');
+            return true;
+        case CommandType::Train:
+            return CommandHandlerT::OnTrain(record.Parameter);
+        case CommandType::PerfDump:
+            CommandHandlerT::OnPerfDump();
             return true;
         default:
             return false;
@@ -171,6 +213,16 @@ public:
         return _state == ParserState::Complete;
     }
 
+    /** Returns the decoded command (when `IsComplete()`).
+     */
+    Record getRecord() const
+    {
+        Record record;
+        record.Command = IsComplete() ? _command : CommandType::None;
+        record.Parameter = _params.GetAt(0);
+        return record;
+    }
+
 private:
     ParserState _state = ParserState::Idle;
     CommandType _command = CommandType::None;
@@ -0,0 +1,307 @@
+#pragma once
+#include <stdint.h>
+#include "../lib/atl/BitArray.h"
+#include "../lib/atl/Time.h"
+#include "MotorController.h"
+
+/** The speed settings that travel with a train from block to block.
+ */
+struct SpeedProfile
+{
+    /** The speed the train runs at on a free track. */
+    uint8_t Cruise;
+};
+
+/** A train that is known to the tracker.
+ */
+struct Train
+{
+    static const uint8_t NoTrainId = 0;
+
+    uint8_t Id;
+    Direction Dir;
+    SpeedProfile Speed;
+    // the block the front of the train is in
+    uint8_t HeadBlock;
+    // time (ticks) the front of the train entered the HeadBlock
+    uint32_t EnteredAt;
+};
+
+/** The TrainTracker keeps track of which train occupies which block.
+ *  When occupancy moves from a block to its successor (or predecessor when running backward)
+ *  the train id, direction and speed profile are carried forward to the new block.
+ *  Blocks are connected in a loop: the successor of the last block is the first block.
+ *  \tparam TimeT is the Time class used to timestamp block changes. TimeT implements `uint32_t getTicks()`.
+ *  \tparam BlockCount is the number of blocks on the node.
+ *  \tparam MaxTrains is the maximum number of trains that can be tracked at the same time.
+ */
+template <class TimeT, const uint8_t BlockCount, const uint8_t MaxTrains>
+class TrainTracker
+{
+    static_assert(BlockCount > 1, "TrainTracker needs at least 2 blocks.");
+    static_assert(BlockCount <= 8, "TrainTracker supports a maximum of 8 blocks.");
+
+    static const uint8_t NoTrain = 0xFF;
+
+public:
+    TrainTracker()
+    {
+        Clear();
+    }
+
+    /** Removes all trains.
+     */
+    void Clear()
+    {
+        for (uint8_t i = 0; i < MaxTrains; i++)
+            _trains[i].Id = Train::NoTrainId;
+        for (uint8_t i = 0; i < BlockCount; i++)
+            _blockTrains[i] = NoTrain;
+        _changedBlocks.ResetAll();
+    }
+
+    /** Places a train in a block. An existing train with the same id is moved.
+     *  \param blockIndex is the zero-based index of the block the train is in.
+     *  \param trainId identifies the train, cannot be NoTrainId.
+     *  \param direction is the direction the train is travelling in.
+     *  \param speed is the speed profile for the train.
+     *  \return Returns false if the parameters are invalid or the table is full.
+     */
+    bool Assign(uint8_t blockIndex, uint8_t trainId, Direction direction, SpeedProfile speed)
+    {
+        if (blockIndex >= BlockCount || trainId == Train::NoTrainId)
+            return false;
+
+        uint8_t index = IndexOf(trainId);
+        if (index == NoTrain)
+            index = IndexOf(Train::NoTrainId);
+        if (index == NoTrain)
+            return false;
+
+        ReleaseBlocks(index);
+
+        Train &train = _trains[index];
+        train.Id = trainId;
+        train.Dir = direction;
+        train.Speed = speed;
+        train.HeadBlock = blockIndex;
+        train.EnteredAt = TimeT::getTicks();
+
+        _blockTrains[blockIndex] = index;
+        _changedBlocks.Set(blockIndex);
+        return true;
+    }
+
+    /** Removes the train from the tracker.
+     *  \param trainId identifies the train.
+     *  \return Returns false if the train was not found.
+     */
+    bool Remove(uint8_t trainId)
+    {
+        uint8_t index = IndexOf(trainId);
+        if (index == NoTrain)
+            return false;
+
+        ReleaseBlocks(index);
+        _trains[index].Id = Train::NoTrainId;
+        return true;
+    }
+
+    /** Changes the speed profile of a train.
+     *  The blocks the train occupies are marked as changed.
+     *  \return Returns false if the train was not found.
+     */
+    bool setSpeed(uint8_t trainId, SpeedProfile speed)
+    {
+        uint8_t index = IndexOf(trainId);
+        if (index == NoTrain)
+            return false;
+
+        _trains[index].Speed = speed;
+        MarkBlocksChanged(index);
+        return true;
+    }
+
+    /** Changes the direction of a train.
+     *  The blocks the train occupies are marked as changed.
+     *  \return Returns false if the train was not found.
+     */
+    bool setDirection(uint8_t trainId, Direction direction)
+    {
+        uint8_t index = IndexOf(trainId);
+        if (index == NoTrain)
+            return false;
+
+        _trains[index].Dir = direction;
+        MarkBlocksChanged(index);
+        return true;
+    }
+
+    /** Call when the occupancy of a block has changed.
+     *  When a block becomes occupied the train that has moved into it is determined.
+     *  If more than one train could have entered the block (they approach from both sides)
+     *  the train that has been in its current block the longest is chosen,
+     *  for it is most likely to have reached the end of that block.
+     *  \param blockIndex is the zero-based index of the block.
+     *  \param occupied is the new occupancy state of the block.
+     *  \param time is the time (ticks) the change was detected.
+     *  \return Returns true if a known train has entered the block. The block is marked as changed.
+     */
+    bool OnOccupiedChanged(uint8_t blockIndex, bool occupied, uint32_t time)
+    {
+        if (blockIndex >= BlockCount)
+            return false;
+
+        if (!occupied)
+        {
+            // the tail of the train left the block.
+            // the HeadBlock is kept so the train can be picked up again
+            // if contact was lost on a dirty section of track.
+            _blockTrains[blockIndex] = NoTrain;
+            return false;
+        }
+
+        if (_blockTrains[blockIndex] != NoTrain)
+            return false;
+
+        uint8_t index = FindCandidate(blockIndex, time);
+        if (index == NoTrain)
+            return false;
+
+        Train &train = _trains[index];
+        // a train that lost contact and is found again does not advance
+        if (train.HeadBlock != blockIndex)
+        {
+            train.HeadBlock = blockIndex;
+            train.EnteredAt = time;
+        }
+
+        _blockTrains[blockIndex] = index;
+        _changedBlocks.Set(blockIndex);
+        return true;
+    }
+
+    /** Call when the occupancy of a block has changed now.
+     *  \param blockIndex is the zero-based index of the block.
+     *  \param occupied is the new occupancy state of the block.
+     *  \return Returns true if a known train has entered the block.
+     */
+    bool OnOccupiedChanged(uint8_t blockIndex, bool occupied)
+    {
+        return OnOccupiedChanged(blockIndex, occupied, TimeT::getTicks());
+    }
+
+    /** Retrieves the train in the block.
+     *  \param blockIndex is the zero-based index of the block.
+     *  \param outTrain receives a pointer to the train.
+     *  \return Returns false if no known train occupies the block.
+     */
+    bool TryGetTrain(uint8_t blockIndex, const Train **outTrain) const
+    {
+        if (blockIndex >= BlockCount || _blockTrains[blockIndex] == NoTrain)
+        {
+            *outTrain = nullptr;
+            return false;
+        }
+
+        *outTrain = &_trains[_blockTrains[blockIndex]];
+        return true;
+    }
+
+    /** Retrieves (and clears) the blocks that need their train settings (re)applied.
+     *  \param outBlocks receives a bit for each block that has changed (bit0 = block 0).
+     *  \return Returns false if nothing has changed.
+     */
+    bool TryTakeChangedBlocks(uint8_t *outBlocks)
+    {
+        *outBlocks = _changedBlocks;
+        _changedBlocks.ResetAll();
+        return *outBlocks != 0;
+    }
+
+    uint8_t getBlockCount() const
+    {
+        return BlockCount;
+    }
+
+private:
+    Train _trains[MaxTrains];
+    // index into _trains for each block
+    uint8_t _blockTrains[BlockCount];
+    BitArray<uint8_t> _changedBlocks;
+
+    uint8_t IndexOf(uint8_t trainId) const
+    {
+        for (uint8_t i = 0; i < MaxTrains; i++)
+        {
+            if (_trains[i].Id == trainId)
+                return i;
+        }
+        return NoTrain;
+    }
+
+    // a train can enter the block from the previous block running forward,
+    // from the next block running backward or it can be a train that lost contact in this block.
+    // when there are multiple candidates the one that has been in its block the longest is chosen.
+    uint8_t FindCandidate(uint8_t blockIndex, uint32_t time) const
+    {
+        uint8_t previous = blockIndex == 0 ? BlockCount - 1 : blockIndex - 1;
+        uint8_t next = blockIndex == BlockCount - 1 ? 0 : blockIndex + 1;
+
+        uint8_t candidate = NoTrain;
+        uint32_t candidateAge = 0;
+
+        for (uint8_t i = 0; i < MaxTrains; i++)
+        {
+            const Train &train = _trains[i];
+            if (train.Id == Train::NoTrainId)
+                continue;
+
+            bool canEnter = (train.HeadBlock == previous && train.Dir == Direction::Forward) ||
+                            (train.HeadBlock == next && train.Dir == Direction::Backward) ||
+                            (train.HeadBlock == blockIndex && !IsInAnyBlock(i));
+            if (!canEnter)
+                continue;
+
+            uint32_t age = time - train.EnteredAt;
+            if (candidate == NoTrain || age > candidateAge)
+            {
+                candidate = i;
+                candidateAge = age;
+            }
+        }
+
+        return candidate;
+    }
+
+    bool IsInAnyBlock(uint8_t index) const
+    {
+        for (uint8_t b = 0; b < BlockCount; b++)
+        {
+            if (_blockTrains[b] == index)
+                return true;
+        }
+        return false;
+    }
+
+    void ReleaseBlocks(uint8_t index)
+    {
+        for (uint8_t b = 0; b < BlockCount; b++)
+        {
+            if (_blockTrains[b] == index)
+                _blockTrains[b] = NoTrain;
+        }
+    }
+
+    void MarkBlocksChanged(uint8_t index)
+    {
+        for (uint8_t b = 0; b < BlockCount; b++)
+        {
+            if (_blockTrains[b] == index)
+                _changedBlocks.Set(b);
+        }
+    }
+};
+
+const uint8_t MaxTrainCount = 4;
+typedef TrainTracker<Time<TimeResolution::Milliseconds>, 4, MaxTrainCount> TrainTrackerT;
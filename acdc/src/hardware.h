@@ -2,6 +2,7 @@
 #include "../lib/Twi.h"
 #include "../lib/Port.h"
 #include "../lib/DigitalOutputPin.h"
+#include "../lib/DummyOutputPin.h"
 #include "../lib/VL53L0X.h"
 #include "../lib/INA219.h"
 #include "../lib/PCA9685.h"
@@ -17,7 +18,12 @@ typedef INA219<I2cT, 0x44> Ina219T_2;
 typedef INA219<I2cT, 0x45> Ina219T_3;
 typedef PCA9685<I2cT, 0x46> PwmModuleT;
 
+#ifdef APPROACH_CONTROL
+// the only range sensor (end of block 0): XSHUT is not connected, D6/D7 drive motor 2
+typedef VL53L0X<I2cT, DummyOutputPin<PortPins::D6>, 0x50> VL53L0XT_0;
+#else
 // typedef VL53L0X<I2cT, DigitalOutputPin<PortPins::D6>, 0x50> VL53L0XT_0;
+#endif
 // typedef VL53L0X<I2cT, DigitalOutputPin<PortPins::D7>, 0x51> VL53L0XT_1;
 
 // clang-format off
@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+"""Decodes the tokenized debug log (lib/atl/DebugLog.h) of the acdc firmware.
+
+The firmware only sends the message id (DebugLog_Id("text")): the string table is built here by
+scanning the sources for DebugLog_Id("...") and hashing the texts the same way as Debug.h.
+Text that is not in a log frame (replies, AtlDebugWrite messages) is passed through.
+
+    debuglog.py --table                      print the string table (and id collisions)
+    debuglog.py capture.bin                  decode a captured stream
+    debuglog.py --port /dev/ttyUSB0          decode the serial port live (needs pyserial)
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+FRAME_TYPE = ord('L')
+FRAME_LENGTH = 15
+OVERFLOW_ID = 0
+LEVELS = ['OFF', 'CRITICAL', 'ERROR', 'WARNING', 'INFO', 'TRACE', 'DEBUG']
+ID_PATTERN = re.compile(r'DebugLog_Id\(\s*"((?:[^"\\]|\\.)*)"\s*\)')
+SOURCE_DIRS = ['src', 'lib']
+
+
+def message_id(text):
+    """FNV-1a (32 bit) folded to 16 bits, 0 is reserved: see DebugLogId in Debug.h."""
+    hash = 2166136261
+    for byte in text.encode('latin-1'):
+        hash = ((hash ^ byte) * 16777619) & 0xFFFFFFFF
+    folded = ((hash >> 16) ^ hash) & 0xFFFF
+    return folded if folded != 0 else 1
+
+
+def build_table(root):
+    table = {}
+    for directory in SOURCE_DIRS:
+        for path, _, files in os.walk(os.path.join(root, directory)):
+            for name in files:
+                if not name.endswith(('.h', '.cpp')):
+                    continue
+                with open(os.path.join(path, name), encoding='latin-1') as source:
+                    lines = source.readlines()
+                for line in lines:
+                    # skip the examples in the doc comments
+                    if line.lstrip().startswith(('*', '/', '#')):
+                        continue
+                    for match in ID_PATTERN.finditer(line):
+                        text = match.group(1).encode('latin-1').decode('unicode_escape')
+                        id = message_id(text)
+                        if id in table and table[id] != text:
+                            print('collision 0x%04X: "%s" and "%s"' % (id, table[id], text), file=sys.stderr)
+                        table[id] = text
+    return table
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE: see Crc16.h."""
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_decode(data):
+    """Decodes a COBS frame without its 0x00 delimiter: see Cobs.h."""
+    output = bytearray()
+    index = 0
+    while index < len(data):
+        code = data[index]
+        end = index + code
+        if end > len(data):
+            return None
+        output += data[index + 1:end]
+        index = end
+        if code < 0xFF and index < len(data):
+            output.append(0)
+    return bytes(output)
+
+
+def decode_frame(chunk):
+    """Returns (id, component, level, timestamp, arg0, arg1) or None when the chunk is not a log frame."""
+    frame = cobs_decode(chunk)
+    if frame is None or len(frame) != FRAME_LENGTH or frame[0] != FRAME_TYPE:
+        return None
+    if crc16(frame[:-2]) != (frame[-2] << 8) | frame[-1]:
+        return None
+    return struct.unpack('<HBBIhh', frame[1:-2])
+
+
+def format_record(table, record):
+    id, component, level, timestamp, arg0, arg1 = record
+    level = LEVELS[level] if level < len(LEVELS) else str(level)
+    if id == OVERFLOW_ID:
+        text = '*** %d log records lost' % (arg0 & 0xFFFF)
+    elif id in table:
+        text = table[id]
+        if '{}' in text:
+            text = text.format(arg0, arg1)
+    else:
+        text = '<unknown 0x%04X> %d %d' % (id, arg0, arg1)
+    # same layout as AtlDebugWrite
+    return '%d [%d] %s: %s' % (timestamp, component, level, text)
+
+
+def decode_stream(table, read, write):
+    """Splits the stream on the 0x00 delimiters: a chunk is a log frame or plain text."""
+    chunk = bytearray()
+    while True:
+        data = read()
+        if not data:
+            break
+        for byte in data:
+            if byte != 0:
+                chunk.append(byte)
+                continue
+            if chunk:
+                record = decode_frame(bytes(chunk))
+                if record is not None:
+                    write(format_record(table, record) + '\n')
+                else:
+                    write(chunk.decode('latin-1'))
+            chunk = bytearray()
+    if chunk:
+        write(chunk.decode('latin-1'))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decodes the tokenized acdc debug log.')
+    parser.add_argument('input', nargs='?', help='captured stream (default: stdin)')
+    parser.add_argument('--port', help='serial port to read')
+    parser.add_argument('--baud', type=int, default=1000000, help='baud rate (platformio.ini monitor_speed)')
+    parser.add_argument('--root', default=os.path.join(os.path.dirname(os.path.abspath(__file__)), '..'),
+                        help='firmware root with src and lib')
+    parser.add_argument('--table', action='store_true', help='print the string table and exit')
+    args = parser.parse_args()
+
+    table = build_table(args.root)
+    if args.table:
+        for id, text in sorted(table.items()):
+            print('0x%04X %s' % (id, text))
+        return
+
+    def write(text):
+        sys.stdout.write(text)
+        sys.stdout.flush()
+
+    if args.port:
+        import serial
+        with serial.Serial(args.port, args.baud) as port:
+            try:
+                decode_stream(table, lambda: port.read(max(1, port.in_waiting)), write)
+            except KeyboardInterrupt:
+                pass
+    elif args.input:
+        with open(args.input, 'rb') as input:
+            decode_stream(table, lambda: input.read(4096), write)
+    else:
+        decode_stream(table, lambda: sys.stdin.buffer.read1(4096), write)
+
+
+if __name__ == '__main__':
+    main()